@@ -1,8 +1,13 @@
 #pragma once
 
 #include <hyprutils/memory/SharedPtr.hpp>
+#include <hyprutils/memory/WeakPtr.hpp>
 #include "../buffer/Buffer.hpp"
 #include <drm_fourcc.h>
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace Aquamarine {
     class CBackend;
@@ -17,8 +22,47 @@ namespace Aquamarine {
     enum eAllocatorType {
         AQ_ALLOCATOR_TYPE_GBM = 0,
         AQ_ALLOCATOR_TYPE_DRM_DUMB,
+        AQ_ALLOCATOR_TYPE_SHM,
     };
 
+    typedef std::function<void(std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>>)> FAsyncBuffersCallback;
+
+    // what an allocator has handed out, see IAllocator::stats()
+    struct SAllocatorStats {
+        // bucket i counts allocations that took less than LATENCY_BUCKET_BASE_US << i, the last one all slower ones
+        static constexpr size_t   LATENCY_BUCKETS        = 12;
+        static constexpr uint64_t LATENCY_BUCKET_BASE_US = 32;
+
+        struct SFormat {
+            uint32_t format   = DRM_FORMAT_INVALID;
+            uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+            size_t   buffers  = 0;
+            uint64_t bytes    = 0;
+        };
+
+        // buffers with no swapchain (pooled ones, or ones acquired without a swapchain) are under a null swapchain
+        struct SOwner {
+            Hyprutils::Memory::CWeakPointer<CLegacySwapchain> swapchain;
+            std::string                                       output; // name of the swapchain's scanout output, if it has one
+            size_t                                            buffers = 0;
+            uint64_t                                          bytes   = 0;
+        };
+
+        // buffers alive right now, wherever they are
+        size_t                                liveBuffers = 0, peakBuffers = 0;
+        uint64_t                              liveBytes = 0, peakBytes = 0;
+        size_t                                pooledBuffers = 0;
+        uint64_t                              pooledBytes   = 0;
+
+        uint64_t                              allocations = 0, failures = 0, poolHits = 0;
+        std::array<uint64_t, LATENCY_BUCKETS> latency = {0};
+
+        std::vector<SFormat>                  formats;
+        std::vector<SOwner>                   owners;
+    };
+
+    struct SAllocatorLedger;
+
     class IAllocator {
       public:
         virtual ~IAllocator()                                                                                                                                      = default;
@@ -27,5 +71,47 @@ namespace Aquamarine {
         virtual int                                         drmFD()                                                                                                = 0;
         virtual eAllocatorType                              type()                                                                                                 = 0;
         virtual void                                        destroyBuffers();
+
+        // Allocates count buffers like acquire() would, with the expensive part on a worker thread if the allocator can do that.
+        // done gets them on the backend's thread, or nothing if any of them failed. It may be called before this returns.
+        virtual void                                        acquireAsync(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain,
+                                                                         size_t count, FAsyncBuffersCallback done);
+
+        // waits for all pending acquireAsync() calls and calls their callbacks
+        virtual void                                        flushAsync();
+
+        // Hands a buffer from acquire() back once it's not needed anymore. Instead of being freed, it's kept for a later acquire()
+        // with the same params for the same output, up to POOL_MAX_BYTES in total (the oldest is freed first).
+        void                                                recycle(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+
+        // frees pooled buffers, oldest first, until at most maxBytes are left pooled. Returns how many were freed
+        size_t                                              trimPool(uint64_t maxBytes = 0);
+        size_t                                              pooledBuffers();
+        uint64_t                                            pooledBytes();
+
+        // a 4K swapchain's worth of 32bpp buffers
+        static constexpr uint64_t                           POOL_MAX_BYTES = 128ULL * 1024 * 1024;
+
+        // Live buffer counts, memory by format, modifier and owning swapchain, and allocation latencies.
+        // Kept up to date as buffers come and go, so this is cheap to call at any time
+        SAllocatorStats                                     stats();
+
+      protected:
+        // a pooled buffer allocated for the same params and target as this request would be, nullptr if there's none.
+        // Only buffers nobody else holds anymore are handed out.
+        Hyprutils::Memory::CSharedPointer<IBuffer> takeFromPool(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain);
+
+        // remembers what a new buffer was allocated for, so that recycle() can pool it
+        void tagForPool(Hyprutils::Memory::CSharedPointer<IBuffer> buffer, const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain);
+
+        // accounts a new buffer in stats(), until it's destroyed. bytes is its real size in memory, latencyNs how long allocating it took
+        void track(Hyprutils::Memory::CSharedPointer<IBuffer> buffer, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain, uint64_t bytes, uint64_t latencyNs);
+        void trackFailure();
+
+      private:
+        std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> pool; // oldest first
+        Hyprutils::Memory::CSharedPointer<SAllocatorLedger>     ledger;
+
+        SAllocatorLedger&                                       getLedger();
     };
 };
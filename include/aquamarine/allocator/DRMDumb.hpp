@@ -55,12 +55,9 @@ namespace Aquamarine {
       private:
         CDRMDumbAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
 
-        // a vector purely for tracking (debugging) the buffers and nothing more
-        std::vector<Hyprutils::Memory::CWeakPointer<CDRMDumbBuffer>> buffers;
+        Hyprutils::Memory::CWeakPointer<CBackend> backend;
 
-        Hyprutils::Memory::CWeakPointer<CBackend>                    backend;
-
-        int                                                          drmfd = -1;
+        int                                       drmfd = -1;
 
         friend class CDRMDumbBuffer;
         friend class CDRMRenderer;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Allocator.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
 
 struct gbm_device;
 struct gbm_bo;
@@ -9,6 +12,7 @@ namespace Aquamarine {
     class CGBMAllocator;
     class CBackend;
     class CLegacySwapchain;
+    struct SGBMAllocation;
 
     class CGBMBuffer : public IBuffer {
       public:
@@ -24,9 +28,17 @@ namespace Aquamarine {
         virtual void                                   endDataPtr();
 
       private:
-        CGBMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain);
+        // takes the bo from allocation. Has to run on the backend's thread
+        CGBMBuffer(SGBMAllocation& allocation, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain);
+
+        // works out the format, modifiers and flags for params. Has to run on the backend's thread
+        static bool plan(const SAllocatorBufferParams& params, CGBMAllocator* allocator, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain,
+                         SGBMAllocation& allocation);
+        // creates the bo for a planned allocation. Only touches gbm, so it's safe from any thread that has device to itself
+        static void createBO(gbm_device* device, SGBMAllocation& allocation);
 
         Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator;
+        Hyprutils::Memory::CSharedPointer<std::mutex>  deviceLock; // for bos from the allocator's async device, see CGBMAllocator::asyncDevice
 
         // gbm stuff
         gbm_bo*      bo         = nullptr;
@@ -46,7 +58,9 @@ namespace Aquamarine {
         virtual Hyprutils::Memory::CSharedPointer<CBackend>     getBackend();
         virtual int                                             drmFD();
         virtual eAllocatorType                                  type();
-        virtual void                                            destroyBuffers();
+        virtual void                                            acquireAsync(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain_,
+                                                                             size_t count, FAsyncBuffersCallback done);
+        virtual void                                            flushAsync();
 
         //
         Hyprutils::Memory::CWeakPointer<CGBMAllocator> self;
@@ -54,17 +68,26 @@ namespace Aquamarine {
       private:
         CGBMAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
 
-        // a vector purely for tracking (debugging) the buffers and nothing more
-        std::vector<Hyprutils::Memory::CWeakPointer<CGBMBuffer>> buffers;
+        int                                       fd = -1;
+        Hyprutils::Memory::CWeakPointer<CBackend> backend;
+
+        // bos being created on worker threads, see acquireAsync(). Each worker posts a task to pick its job up on the backend's thread
+        struct SAsyncJob;
+        std::vector<std::unique_ptr<SAsyncJob>>       asyncJobs;
 
-        int                                                      fd = -1;
-        Hyprutils::Memory::CWeakPointer<CBackend>                backend;
+        void                                          collectAsyncJobs(bool wait);
+        bool                                          openAsyncDevice();
 
         // gbm stuff
         gbm_device* gbmDevice            = nullptr;
         std::string gbmDeviceBackendName = "";
         std::string drmName              = "";
 
+        // The workers' own device, on a dup of fd, opened on the first acquireAsync(). gbmDevice is the renderer's too, so they stay off it.
+        // Workers and the backend's thread take turns on this one with asyncDeviceLock
+        gbm_device*                                   asyncDevice = nullptr;
+        Hyprutils::Memory::CSharedPointer<std::mutex> asyncDeviceLock;
+
         friend class CGBMBuffer;
         friend class CDRMRenderer;
     };
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Allocator.hpp"
+
+namespace Aquamarine {
+    class CSHMAllocator;
+    class CBackend;
+    class CLegacySwapchain;
+
+    class CSHMBuffer : public IBuffer {
+      public:
+        virtual ~CSHMBuffer();
+
+        virtual eBufferCapability                      caps();
+        virtual eBufferType                            type();
+        virtual void                                   update(const Hyprutils::Math::CRegion& damage);
+        virtual bool                                   isSynchronous();
+        virtual bool                                   good();
+        virtual SSHMAttrs                              shm();
+        virtual std::tuple<uint8_t*, uint32_t, size_t> beginDataPtr(uint32_t flags);
+        virtual void                                   endDataPtr();
+
+      private:
+        // tries hugepages first if hugepages is set, and falls back to regular pages. huge says which it got
+        CSHMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator_,
+                   Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain, bool hugepages);
+
+        // creates and maps the memfd, false if that failed
+        bool                                        map(size_t len, bool hugepages);
+
+        Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator;
+
+        //
+        uint8_t* data    = nullptr; // mapped for the buffer's whole lifetime
+        size_t   dataLen = 0;       // size of the mapping, can be larger than stride * height with hugepages
+        bool     huge    = false;
+
+        //
+        SSHMAttrs attrs{.success = false, .fd = -1};
+
+        friend class CSHMAllocator;
+    };
+
+    // Allocates memfd-backed buffers for cpu rendering, for when there's no drm device to allocate from.
+    // With AQ_SHM_HUGEPAGES, buffers are backed by hugepages if the system has any reserved.
+    class CSHMAllocator : public IAllocator {
+      public:
+        ~CSHMAllocator();
+        static Hyprutils::Memory::CSharedPointer<CSHMAllocator> create(Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer>      acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain_);
+        virtual Hyprutils::Memory::CSharedPointer<CBackend>     getBackend();
+        virtual int                                             drmFD();
+        virtual eAllocatorType                                  type();
+
+        //
+        Hyprutils::Memory::CWeakPointer<CSHMAllocator> self;
+
+      private:
+        CSHMAllocator(Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        Hyprutils::Memory::CWeakPointer<CBackend> backend;
+
+        bool                                      hugepages = false;
+
+        friend class CSHMBuffer;
+    };
+};
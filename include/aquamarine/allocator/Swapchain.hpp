@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Allocator.hpp"
+#include <array>
+#include <hyprutils/math/Region.hpp>
 
 namespace Aquamarine {
 
@@ -15,6 +17,24 @@ namespace Aquamarine {
         Hyprutils::Memory::CWeakPointer<IOutput> scanoutOutput;
     };
     class CLegacySwapchain;
+
+    // Keeps the damage of the last few presented frames, so that a buffer of a given age
+    // knows which parts of it are stale.
+    class CSwapchainDamageRing {
+      public:
+        static constexpr size_t HISTORY = 8;
+
+        // record the damage of a newly presented frame
+        void push(const Hyprutils::Math::CRegion& damage);
+        // the damage a buffer of the given age is missing. The full size if not enough history is kept.
+        Hyprutils::Math::CRegion accumulate(int age, const Hyprutils::Math::Vector2D& size) const;
+        void                     clear();
+
+      private:
+        std::array<Hyprutils::Math::CRegion, HISTORY> frames;
+        size_t                                        head = 0, count = 0;
+    };
+
     class ISwapchain {
       public:
         static Hyprutils::Memory::CSharedPointer<CLegacySwapchain> createLegacy(Hyprutils::Memory::CSharedPointer<IAllocator>             allocator_,
@@ -29,6 +49,14 @@ namespace Aquamarine {
         // useful if e.g. a commit fails and we don't wanna write to the previous buffer that is
         // in use.
         virtual void rollback() = 0;
+
+        // the damage a buffer of the given age (as reported by next()) has to repaint to catch up
+        // with the last presented frame. The whole buffer if the swapchain doesn't track damage.
+        virtual Hyprutils::Math::CRegion damageForAge(int age);
+
+        // the output presented buffer with the given damage. Feeds buffer ages and damageForAge(), buffer may come from outside the swapchain (e.g. direct scanout)
+        virtual void presented(Hyprutils::Memory::CSharedPointer<IBuffer> buffer, const Hyprutils::Math::CRegion& damage);
+
         virtual ~ISwapchain();
     };
     class CLegacySwapchain: public ISwapchain {
@@ -45,11 +73,24 @@ namespace Aquamarine {
         // in use.
         virtual void rollback();
 
+        virtual Hyprutils::Math::CRegion damageForAge(int age);
+        virtual void                     presented(Hyprutils::Memory::CSharedPointer<IBuffer> buffer, const Hyprutils::Math::CRegion& damage);
+
+        // Starts allocating the buffers for options_ in the background (see IAllocator::acquireAsync), e.g. for a mode that's about to be committed.
+        // A later reconfigure() to the same options swaps them in instead of allocating. If they're not done yet, it allocates without them.
+        // Returns false if there's nothing to prepare.
+        bool preallocate(const SSwapchainOptions& options_);
+
+        // whether buffers for options_ are allocated and ready to be swapped in
+        bool preallocated(const SSwapchainOptions& options_);
+
       private:
         CLegacySwapchain(Hyprutils::Memory::CSharedPointer<IAllocator> allocator_, Hyprutils::Memory::CSharedPointer<IBackendImplementation> backendImpl_);
 
         bool fullReconfigure(const SSwapchainOptions& options_);
         bool resize(size_t newSize);
+        bool takePreallocated(const SSwapchainOptions& options_, std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>>& out);
+        void dropPreallocated();
 
         //
         Hyprutils::Memory::CWeakPointer<CLegacySwapchain>             self;
@@ -59,7 +100,24 @@ namespace Aquamarine {
         std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> buffers;
         int                                                     lastAcquired = 0;
 
+        // per buffer, same order as buffers. 0 means never presented / never acquired
+        struct SBufferHistory {
+            uint64_t lastPresented = 0, lastAcquired = 0;
+        };
+        std::vector<SBufferHistory>                             history;
+        uint64_t                                                presentSeq = 0, acquireSeq = 0;
+        CSwapchainDamageRing                                    damageRing;
+
+        struct {
+            SSwapchainOptions                                       options;
+            std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> buffers;
+            bool                                                    inFlight = false;
+            uint64_t                                                seq      = 0; // results of older preallocate() calls are dropped
+        } prepared;
+
         friend class CGBMBuffer;
+        friend class CSHMBuffer;
         friend class ISwapchain;
+        friend class IAllocator;
     };
 };
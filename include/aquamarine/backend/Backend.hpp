@@ -6,9 +6,13 @@
 #include <hyprutils/cli/Logger.hpp>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <unordered_map>
 #include "../allocator/Allocator.hpp"
+#include "../misc/TaskQueue.hpp"
 #include "Misc.hpp"
 #include "Session.hpp"
 
@@ -130,6 +134,32 @@ namespace Aquamarine {
         /* remove an idle event from the queue */
         void removeIdleEvent(Hyprutils::Memory::CSharedPointer<std::function<void(void)>> pfn);
 
+        /* run fn on the thread dispatching the backend's poll fds. Safe to call from any thread */
+        void postTask(std::function<void(void)> fn);
+
+        /* like postTask, for threads that may outlive the backend: the gate is closed once the backend starts going away */
+        std::shared_ptr<CTaskGate> getTaskGate();
+
+        /* run fn once, timeoutMs from now. Timers fire through getPollFDs(), so they work with your own loop too */
+        void addTimer(Hyprutils::Memory::CSharedPointer<std::function<void(void)>> fn, uint64_t timeoutMs);
+
+        /* same, but at an absolute CLOCK_MONOTONIC time in nanoseconds */
+        void addTimerAt(Hyprutils::Memory::CSharedPointer<std::function<void(void)>> fn, uint64_t monotonicNs);
+
+        /* cancel a timer that hasn't fired yet */
+        void removeTimer(Hyprutils::Memory::CSharedPointer<std::function<void(void)>> pfn);
+
+        /*
+            Built-in event loop, optional. If you use it, you don't need to poll getPollFDs() yourself.
+            enterLoop() dispatches until stopLoop() is called, returns false on a fatal error.
+            dispatchOnce() waits up to timeoutMs (-1 for forever) and dispatches whatever is ready.
+            stopLoop() and wakeLoop() are safe to call from any thread, wakeLoop() makes a waiting dispatchOnce() return.
+        */
+        bool enterLoop();
+        bool dispatchOnce(int timeoutMs = -1);
+        void stopLoop();
+        void wakeLoop();
+
         // utils
         int reopenDRMNode(int drmFD, bool allowRenderNode = true);
 
@@ -168,22 +198,57 @@ namespace Aquamarine {
         std::vector<Hyprutils::Memory::CSharedPointer<SPollFD>>                sessionFDs;
         Hyprutils::Memory::CSharedPointer<CLogger>                             logger;
 
+        // slot of the open-addressed index from a queued idle callback to its position in idle.pending
+        struct SIdleSlot {
+            std::function<void(void)>* key        = nullptr;
+            uint32_t                   index      = 0; // UINT32_MAX once removed
+            uint32_t                   generation = 0;
+        };
+
         struct {
             int                                                                       fd = -1;
-            std::vector<Hyprutils::Memory::CSharedPointer<std::function<void(void)>>> pending;
+            std::vector<Hyprutils::Memory::CSharedPointer<std::function<void(void)>>> pending, dispatching; // removed entries are left as nullptr
+            std::vector<SIdleSlot>                                                    slots;
+            uint32_t                                                                  generation = 1; // bumped per dispatch, slots of older generations are free
+            size_t                                                                    usedSlots  = 0;
+            bool                                                                      armed      = false;
         } idle;
 
-        void dispatchIdle();
-        void updateIdleTimer();
+        void       dispatchIdle();
+        void       updateIdleTimer();
+        SIdleSlot* findIdleSlot(std::function<void(void)>* key);
+        void       insertIdleSlot(std::function<void(void)>* key, uint32_t index);
+
+        struct STimer {
+            Hyprutils::Memory::CSharedPointer<std::function<void(void)>> fn;
+            uint64_t                                                     expiresNs = 0; // CLOCK_MONOTONIC
+        };
+
+        struct {
+            int                 fd = -1;
+            std::vector<STimer> timers;
+            std::vector<STimer> firing; // scratch for dispatchTimers
+        } timers;
+
+        void dispatchTimers();
+        void updateTimerFD();
+
+        // tasks posted from other threads, drained when its eventfd fires
+        CTaskQueue                 tasks;
+        std::shared_ptr<CTaskGate> taskGate;
 
-        //
+        // state of the built-in loop. fds mirrors what's registered with epoll and is only resynced after pollFDsChanged
         struct {
-            std::condition_variable loopSignal;
-            std::mutex              loopMutex;
-            std::atomic<bool>       shouldProcess = false;
-            std::mutex              loopRequestMutex;
-            std::mutex              eventLock;
-        } m_sEventLoopInternals;
+            int                                                                 epollFD = -1;
+            int                                                                 wakeFD  = -1; // eventfd
+            std::atomic<bool>                                                   running = false;
+            bool                                                                dirty   = true;
+            std::unordered_map<int, Hyprutils::Memory::CSharedPointer<SPollFD>> fds;
+            Hyprutils::Signal::CHyprSignalListener                              pollFDsChanged;
+        } loop;
+
+        bool initLoop();
+        void syncLoopFDs();
 
         friend class CDRMBackend;
     };
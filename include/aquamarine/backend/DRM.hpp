@@ -219,7 +219,6 @@ namespace Aquamarine {
 
         Hyprutils::Memory::CWeakPointer<CDRMBackend>                 backend;
         Hyprutils::Memory::CSharedPointer<SDRMConnector>             connector;
-        Hyprutils::Memory::CSharedPointer<std::function<void(void)>> frameIdle;
 
         struct {
             Hyprutils::Memory::CSharedPointer<ISwapchain> swapchain;
@@ -297,7 +296,6 @@ namespace Aquamarine {
 
         bool                                           isPageFlipPending = false;
         SDRMPageFlip                                   pendingPageFlip;
-        bool                                           frameEventScheduled = false;
 
         // the current state is invalid and won't commit, don't try to modeset.
         bool                                           commitTainted = false;
@@ -25,10 +25,7 @@ namespace Aquamarine {
       private:
         CHeadlessOutput(const std::string& name_, Hyprutils::Memory::CWeakPointer<CHeadlessBackend> backend_);
 
-        Hyprutils::Memory::CWeakPointer<CHeadlessBackend>        backend;
-
-        Hyprutils::Memory::CSharedPointer<std::function<void()>> framecb;
-        bool                                                     frameScheduled = false;
+        Hyprutils::Memory::CWeakPointer<CHeadlessBackend> backend;
 
         friend class CHeadlessBackend;
     };
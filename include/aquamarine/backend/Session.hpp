@@ -5,6 +5,9 @@
 #include <hyprutils/memory/SharedPtr.hpp>
 #include "../input/Input.hpp"
 #include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 struct udev;
 struct udev_monitor;
@@ -20,6 +23,9 @@ namespace Aquamarine {
     class CSession;
     class CLibinputDevice;
     struct SPollFD;
+    struct SInputThread;
+    struct SInputLock;
+    struct SLibinputEvent;
 
     class CSessionDevice {
       public:
@@ -222,6 +228,12 @@ namespace Aquamarine {
         bool                                                            switchVT(uint32_t vt);
         void                                                            onReady();
 
+        /*
+            With AQ_INPUT_THREAD=1, libinput is read on its own thread. If you call into libinput yourself (e.g. libinput_device_config_*),
+            do it in fn, which runs with the input thread kept out. Input signals already run that way, so calling this from them is fine too.
+        */
+        void                                                            withLibinput(const std::function<void()>& fn);
+
         struct SAddDrmCardEvent {
             std::string path;
         };
@@ -241,8 +253,20 @@ namespace Aquamarine {
         void                                                    dispatchLibseatEvents();
         void                                                    handleLibinputEvent(libinput_event* e);
         void                                                    handleLibinputTabletToolAxis(libinput_event* e);
+        void                                                    emitLibinputEvent(Hyprutils::Memory::CSharedPointer<CLibinputDevice> dev, const SLibinputEvent& event);
+
+        // guards libinput, libseat and sessionDevices against the input thread. The main thread takes it through SInputLock
+        std::mutex                                              inputLock;
+        bool                                                    inputLockHeld = false; // by the main thread
+
+        std::unique_ptr<SInputThread>                           inputThread;
+        void                                                    startInputThread();
+        void                                                    stopInputThread();
+        void                                                    inputThreadMain();
+        void                                                    dispatchInputThreadEvents();
 
         friend class CSessionDevice;
         friend class CLibinputDevice;
+        friend struct SInputLock;
     };
 };
@@ -3,9 +3,13 @@
 #include "./Backend.hpp"
 #include "../allocator/Swapchain.hpp"
 #include "../output/Output.hpp"
+#include "../input/Input.hpp"
 #include <hyprutils/memory/WeakPtr.hpp>
 #include <tab_client.h>
 #include <ctime>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
 
 namespace Aquamarine {
     class CBackend;
@@ -16,6 +20,7 @@ namespace Aquamarine {
     class ITouch;
     class ITablet;
     class ITabletPad;
+    class ITabletTool;
     class ISwitch;
 
     class CTabOutput : public IOutput {
@@ -34,15 +39,28 @@ namespace Aquamarine {
       private:
         CTabOutput(const TabMonitorInfo& monitor_info, Hyprutils::Memory::CWeakPointer<CTabBackend> backend_);
 
+        void     swapBuffers(TabClientHandle* client, const Hyprutils::Math::CRegion& damage);
+        void     swapQueued(TabClientHandle* client);
+        bool     canStartFrame();
+        void     onConnectionLost();
+        void     reconcile(const TabMonitorInfo& monitor_info, TabClientHandle* client);
+
+        // mailbox only: a committed frame held back while Shift still has the previous one, sent on FRAME_DONE
+        struct {
+            bool                     pending = false;
+            uint64_t                 acquire = 0; // swapchain acquire count when it was committed
+            Hyprutils::Math::CRegion damage;
+        } queued;
+
         Hyprutils::Memory::CWeakPointer<CTabBackend> backend;
         std::string                                  monitorID;
+        uint32_t                                     handle            = 0;
         int                                          refreshRateHz     = 60;
         int                                          refreshIntervalNs = 0;
         timespec                                     lastPresentTime {};
         uint32_t                                     presentSeq = 0;
-        bool                                         frameEventScheduled = false;
         bool                                         awaitingFrameDone = false;
-        Hyprutils::Memory::CSharedPointer<std::function<void(void)>> frameIdle;
+        size_t                                       framesInFlight    = 0;
 
         friend class CTabBackend;
     };
@@ -77,15 +95,60 @@ namespace Aquamarine {
         std::vector<Hyprutils::Memory::CSharedPointer<CTabOutput>> outputs;
         TabClientHandle*                                           client = nullptr;
 
+        // Shift names monitors with strings, we look them up once per event. IDs are interned into handles that index outputsByHandle.
+        struct SMonitorIDHash {
+            using is_transparent = void;
+            size_t operator()(std::string_view id) const {
+                return std::hash<std::string_view>{}(id);
+            }
+        };
+        std::unordered_map<std::string, uint32_t, SMonitorIDHash, std::equal_to<>> monitorHandles;
+        std::vector<Hyprutils::Memory::CSharedPointer<CTabOutput>>                  outputsByHandle;
+
         Hyprutils::Memory::CSharedPointer<IKeyboard>   keyboard;
         Hyprutils::Memory::CSharedPointer<IPointer>    pointer;
         Hyprutils::Memory::CSharedPointer<ITouch>      touch;
         Hyprutils::Memory::CSharedPointer<ITablet>     tablet;
         Hyprutils::Memory::CSharedPointer<ITabletPad>  tabletPad;
         Hyprutils::Memory::CSharedPointer<ISwitch>     switchDev;
+        Hyprutils::Memory::CSharedPointer<ITabletTool> tabletTool;
+
+        // keys and pointer buttons currently down, released by us if the connection drops
+        struct {
+            std::vector<uint32_t> keys;
+            std::vector<uint32_t> buttons;
+        } held;
+
+        // AQ_TAB_RENDER_DEADLINE, outputs' frame schedulers use adaptive timing
+        bool renderDeadline = false;
+
+        // AQ_TAB_MAILBOX, outputs triple-buffer and the newest committed frame replaces one that's held back
+        bool mailbox = false;
+
+        // while the connection to Shift is down, the timer paces reconnection attempts. backoffMs is 0 when connected
+        struct {
+            int      timerfd   = -1;
+            uint64_t backoffMs = 0;
+        } reconnect;
+
+        // opt-in (AQ_TAB_COALESCE_INPUT) merging of consecutive relative motion and scroll events within one dispatch
+        struct {
+            bool                                enabled = false;
+            std::optional<IPointer::SMoveEvent> move;
+            std::optional<IPointer::SAxisEvent> axis;
+        } coalesce;
 
         TabClientHandle* ensureClient();
-        CTabOutput*      findOutputByID(const std::string& id);
+        uint32_t         internMonitorID(std::string_view id);
+        CTabOutput*      findOutputByID(std::string_view id);
+        void             flushCoalescedInput();
+        void             releaseHeldInput();
+        void             syncMonitors();
+        bool             connectionLost();
+        void             onDisconnected();
+        void             armReconnect();
+        void             tryReconnect();
+        Hyprutils::Memory::CSharedPointer<ITabletTool> ensureTabletTool();
 
         friend class CTabOutput;
     };
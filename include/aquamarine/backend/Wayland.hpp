@@ -79,9 +79,7 @@ namespace Aquamarine {
         void                                              onEnter(Hyprutils::Memory::CSharedPointer<CCWlPointer> pointer, uint32_t serial);
 
         // frame loop
-        bool frameScheduledWhileWaiting = false;
-        bool readyForFrameCallback      = false; // true after attaching a buffer
-        bool frameScheduled             = false;
+        bool readyForFrameCallback = false; // true after attaching a buffer
 
         struct {
             std::vector<std::pair<Hyprutils::Memory::CWeakPointer<IBuffer>, Hyprutils::Memory::CSharedPointer<CWaylandBuffer>>> buffers;
@@ -160,6 +158,7 @@ namespace Aquamarine {
 
         void initSeat();
         void initShell();
+        void initShm();
         bool initDmabuf();
 
         //
@@ -179,6 +178,9 @@ namespace Aquamarine {
         // dmabuf formats
         std::vector<SDRMFormat> dmabufFormats;
 
+        // wl_shm formats, for when there's no drm device and buffers are shm
+        std::vector<SDRMFormat> shmFormats;
+
         struct {
             wl_display* display = nullptr;
 
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+
+namespace Aquamarine {
+    // CTaskQueue is a multi-producer, single-consumer queue of tasks to run on one thread.
+    // push() is lock-free and safe from any thread. drain() must only ever be called from the consuming thread,
+    // it runs when fd() (an eventfd) becomes readable.
+    class CTaskQueue {
+      public:
+        CTaskQueue();
+        ~CTaskQueue();
+
+        CTaskQueue(const CTaskQueue&)            = delete;
+        CTaskQueue& operator=(const CTaskQueue&) = delete;
+
+        void   push(std::function<void(void)>&& fn);
+
+        // runs up to maxTasks queued tasks, returns how many ran. If any are left, fd() stays readable.
+        size_t drain(size_t maxTasks = 256);
+
+        int    fd() const;
+
+      private:
+        struct SNode {
+            std::atomic<SNode*>       next = nullptr;
+            std::function<void(void)> fn;
+        };
+
+        void   link(SNode* node);
+        SNode* pop();
+        void   signal();
+
+        std::atomic<SNode*> head; // producers
+        SNode*              tail; // consumer
+        SNode               stub;
+        std::atomic<bool>   signalled = false;
+        int                 eventFD   = -1;
+    };
+
+    // CTaskGate lets threads that may outlive a queue's owner post to it. The owner closes it before the queue goes away,
+    // after that post() refuses and leaves fn with the caller. Share it with std::shared_ptr, whose count any thread may touch.
+    class CTaskGate {
+      public:
+        CTaskGate(CTaskQueue* queue_);
+
+        CTaskGate(const CTaskGate&)            = delete;
+        CTaskGate& operator=(const CTaskGate&) = delete;
+
+        // moves fn into the queue and returns true, unless the gate is closed
+        bool post(std::function<void(void)>& fn);
+        void close();
+
+      private:
+        std::mutex  lock;
+        CTaskQueue* queue = nullptr;
+    };
+};
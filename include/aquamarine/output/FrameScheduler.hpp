@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <hyprutils/memory/SharedPtr.hpp>
+#include <hyprutils/memory/WeakPtr.hpp>
+#include "Output.hpp"
+
+namespace Aquamarine {
+    class CBackend;
+
+    /*
+        Decides when an output emits frame. Every backend's output owns one:
+        scheduleFrame() requests go in, present feedback keeps the vblank prediction up to date,
+        and the output's gate says whether it can take a frame at all (e.g. a page flip is still pending).
+        Requests made before the frame goes out are merged into it.
+    */
+    class CFrameScheduler {
+      public:
+        enum eFrameTiming : uint8_t {
+            AQ_FRAME_TIMING_ASAP = 0, // frame as soon as the output can take one
+            AQ_FRAME_TIMING_OFFSET,   // frame offsetNs before the predicted vblank
+            AQ_FRAME_TIMING_ADAPTIVE, // frame as late as the measured render time and presentation latency (plus offsetNs of slack) allow
+        };
+
+        // canFrame is the output's gate, onFrame emits the frame
+        CFrameScheduler(Hyprutils::Memory::CWeakPointer<CBackend> backend_, std::function<bool()> canFrame_, std::function<void()> onFrame_);
+        ~CFrameScheduler();
+
+        CFrameScheduler(const CFrameScheduler&)            = delete;
+        CFrameScheduler& operator=(const CFrameScheduler&) = delete;
+
+        // request a frame. If the gate is closed, the request waits for the next schedule() or dispatch()
+        void     schedule(IOutput::scheduleFrameReason reason);
+
+        // like schedule(), but emits right away unless the timing says to wait. For when the output just became free, e.g. after a present
+        void     dispatch(IOutput::scheduleFrameReason reason);
+
+        // drops a frame that's been scheduled but not emitted yet (requests are kept), and forgets one that was emitted but never committed
+        void     cancel();
+
+        // present feedback, in CLOCK_MONOTONIC. refreshNs is 0 if the refresh is unknown or variable, which disables vblank prediction
+        void     presented(const timespec& when, uint64_t refreshNs);
+
+        // the compositor committed after a frame, feeds the render time estimate
+        void     committed();
+
+        // offsetNs is the lead before the vblank for AQ_FRAME_TIMING_OFFSET, and the slack on top of the render time for AQ_FRAME_TIMING_ADAPTIVE
+        void     setTiming(eFrameTiming timing_, uint64_t offsetNs_ = 0);
+
+        // predicted CLOCK_MONOTONIC time of the next vblank in ns, 0 if there's nothing to predict from
+        uint64_t predictNextVblank() const;
+
+        // whether a frame is scheduled and not emitted yet
+        bool     scheduled() const;
+
+        // whether a frame was requested while the gate was closed, and is still waiting for it
+        bool     pending() const;
+
+        // 1 << scheduleFrameReason of every request merged into the next frame
+        uint32_t reasons() const;
+
+        // same, for the last frame emitted. Valid in frame handlers
+        uint32_t frameReasons() const;
+
+        // running estimate of how long the compositor takes from frame to commit, 0 if unknown
+        uint64_t renderTimeNs() const;
+
+        // AQ_FRAME_TIMING_ADAPTIVE only: how long before the vblank a commit has to land to make it, learnt from missed vblanks
+        uint64_t presentLatencyNs() const;
+
+        // set by the owner right after makeShared, the idle and timer callbacks go through it
+        Hyprutils::Memory::CWeakPointer<CFrameScheduler> self;
+
+      private:
+        void                                                         arm();
+        void                                                         fire();
+        uint64_t                                                     targetNs() const;
+
+        Hyprutils::Memory::CWeakPointer<CBackend>                    backend;
+        std::function<bool()>                                        canFrame;
+        std::function<void()>                                        onFrame;
+
+        eFrameTiming                                                 timing   = AQ_FRAME_TIMING_ASAP;
+        uint64_t                                                     offsetNs = 0;
+
+        bool                                                         wanted        = false;
+        bool                                                         armed         = false;
+        uint32_t                                                     mergedReasons = 0;
+        uint32_t                                                     lastReasons   = 0;
+
+        uint64_t                                                     lastVblankNs   = 0;
+        uint64_t                                                     refreshNs      = 0;
+        uint64_t                                                     frameEmittedNs = 0;
+        uint64_t                                                     renderNs       = 0;
+        uint64_t                                                     latencyNs      = 0;
+        uint64_t                                                     committedNs    = 0;
+        uint64_t                                                     targetVblankNs = 0; // the vblank the last commit was aiming for
+
+        Hyprutils::Memory::CSharedPointer<std::function<void(void)>> idle;
+        Hyprutils::Memory::CSharedPointer<std::function<void(void)>> timer;
+        bool                                                         timerArmed = false;
+    };
+};
@@ -16,6 +16,7 @@ namespace Aquamarine {
 
     class IBackendImplementation;
     class CTabOutput;
+    class CFrameScheduler;
 
     struct SOutputMode {
         Hyprutils::Math::Vector2D      pixelSize;
@@ -190,6 +191,9 @@ namespace Aquamarine {
 
         Hyprutils::Memory::CSharedPointer<ISwapchain>               swapchain;
 
+        // decides when frame is emitted, see FrameScheduler.hpp. It belongs to the output and goes away with it
+        Hyprutils::Memory::CWeakPointer<CFrameScheduler>            getFrameScheduler();
+
         //
 
         enum eOutputPresentFlags : uint32_t {
@@ -218,5 +222,9 @@ namespace Aquamarine {
             Hyprutils::Signal::CSignalT<>              commit;
             Hyprutils::Signal::CSignalT<SStateEvent>   state;
         } events;
+
+      protected:
+        // every backend sets one up. Its callbacks capture the output, so only the output may own it
+        Hyprutils::Memory::CSharedPointer<CFrameScheduler> frameScheduler;
     };
 }
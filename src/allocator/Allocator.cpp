@@ -1,3 +1,301 @@
+#include <algorithm>
+#include <optional>
 #include <aquamarine/allocator/Allocator.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/output/Output.hpp>
 
-void Aquamarine::IAllocator::destroyBuffers() {}
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+#define WP CWeakPointer
+
+// What a buffer was allocated for, and the format and modifier it got. Buffers with the same params and target are interchangeable,
+// as long as what the target supports hasn't changed since.
+class CBufferPoolKey : public IAttachment {
+  public:
+    SAllocatorBufferParams     params;
+    WP<IBackendImplementation> backendImpl;
+    WP<IOutput>                scanoutOutput;
+    bool                       explicitScanout = false;
+    uint32_t                   format          = DRM_FORMAT_INVALID;
+    uint64_t                   modifier        = DRM_FORMAT_MOD_INVALID; // invalid for implicit modifiers, and buffers that aren't dmabufs
+
+    // whatever it was allocated for is gone
+    bool stale() const {
+        return backendImpl.expired() || (explicitScanout && scanoutOutput.expired());
+    }
+
+    // whether the target still takes the buffer's modifier. Implicit and linear are what allocators fall back to on their own, those always do
+    bool supported(const std::vector<SDRMFormat>& formats) const {
+        if (modifier == DRM_FORMAT_MOD_INVALID || modifier == DRM_FORMAT_MOD_LINEAR || formats.empty())
+            return true;
+
+        auto it = std::ranges::find_if(formats, [this](const auto& f) { return f.drmFormat == format; });
+        return it != formats.end() && std::ranges::find(it->modifiers, modifier) != it->modifiers.end();
+    }
+
+    bool matches(const SAllocatorBufferParams& params_, const WP<IBackendImplementation>& backendImpl_, const WP<IOutput>& scanoutOutput_) const {
+        if (params.size != params_.size || params.format != params_.format || params.scanout != params_.scanout || params.cursor != params_.cursor ||
+            params.multigpu != params_.multigpu)
+            return false;
+
+        return backendImpl.get() == backendImpl_.get() && explicitScanout == !scanoutOutput_.expired() && scanoutOutput.get() == scanoutOutput_.get();
+    }
+};
+
+// Running totals behind IAllocator::stats(). Buffers can outlive their allocator, so they reach this weakly
+struct Aquamarine::SAllocatorLedger {
+    SAllocatorStats stats;
+
+    void account(uint32_t format, uint64_t modifier, const WP<CLegacySwapchain>& owner, uint64_t bytes, bool add) {
+        if (add) {
+            stats.liveBuffers++;
+            stats.liveBytes += bytes;
+            stats.peakBuffers = std::max(stats.peakBuffers, stats.liveBuffers);
+            stats.peakBytes   = std::max(stats.peakBytes, stats.liveBytes);
+        } else {
+            stats.liveBuffers--;
+            stats.liveBytes -= bytes;
+        }
+
+        // a handful of formats and swapchains at most, a linear search is the cheapest
+        auto fmt = std::ranges::find_if(stats.formats, [format, modifier](const auto& f) { return f.format == format && f.modifier == modifier; });
+        if (fmt == stats.formats.end()) {
+            if (!add)
+                return;
+            fmt = stats.formats.insert(stats.formats.end(), SAllocatorStats::SFormat{.format = format, .modifier = modifier});
+        }
+
+        fmt->buffers = add ? fmt->buffers + 1 : fmt->buffers - 1;
+        fmt->bytes   = add ? fmt->bytes + bytes : fmt->bytes - bytes;
+        if (fmt->buffers == 0)
+            stats.formats.erase(fmt);
+
+        own(owner, bytes, add);
+    }
+
+    void own(const WP<CLegacySwapchain>& owner, uint64_t bytes, bool add) {
+        auto it = std::ranges::find_if(stats.owners, [&owner](const auto& o) { return o.swapchain == owner; });
+        if (it == stats.owners.end()) {
+            if (!add)
+                return;
+            it = stats.owners.insert(stats.owners.end(), SAllocatorStats::SOwner{.swapchain = owner});
+        }
+
+        it->buffers = add ? it->buffers + 1 : it->buffers - 1;
+        it->bytes   = add ? it->bytes + bytes : it->bytes - bytes;
+        if (it->buffers == 0)
+            stats.owners.erase(it);
+    }
+};
+
+// what a buffer counts for in the ledger, taken off again when the buffer goes
+class CBufferAccounting : public IAttachment {
+  public:
+    WP<SAllocatorLedger> ledger;
+    uint32_t             format   = DRM_FORMAT_INVALID;
+    uint64_t             modifier = DRM_FORMAT_MOD_INVALID;
+    uint64_t             bytes    = 0;
+    WP<CLegacySwapchain> owner;
+
+    virtual ~CBufferAccounting() {
+        if (auto l = ledger.lock())
+            l->account(format, modifier, owner, bytes, false);
+    }
+
+    void setOwner(const WP<CLegacySwapchain>& owner_) {
+        if (owner == owner_)
+            return;
+
+        if (auto l = ledger.lock()) {
+            l->own(owner, bytes, false);
+            l->own(owner_, bytes, true);
+        }
+
+        owner = owner_;
+    }
+};
+
+void Aquamarine::IAllocator::destroyBuffers() {
+    trimPool();
+}
+
+void Aquamarine::IAllocator::acquireAsync(const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain, size_t count, FAsyncBuffersCallback done) {
+    // nothing to offload, allocate right away
+    std::vector<SP<IBuffer>> result;
+    for (size_t i = 0; i < count; ++i) {
+        auto buffer = acquire(params, swapchain);
+        if (!buffer) {
+            for (auto const& b : result) {
+                recycle(b);
+            }
+            result.clear();
+            break;
+        }
+        result.emplace_back(buffer);
+    }
+
+    done(std::move(result));
+}
+
+void Aquamarine::IAllocator::flushAsync() {
+    ; // acquireAsync() is synchronous
+}
+
+void Aquamarine::IAllocator::tagForPool(SP<IBuffer> buffer, const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain) {
+    if (!buffer || !swapchain)
+        return;
+
+    auto key             = makeShared<CBufferPoolKey>();
+    key->params          = params;
+    key->backendImpl     = swapchain->backendImpl;
+    key->scanoutOutput   = swapchain->currentOptions().scanoutOutput;
+    key->explicitScanout = !key->scanoutOutput.expired();
+    if (auto attrs = buffer->dmabuf(); attrs.success) {
+        key->format   = attrs.format;
+        key->modifier = attrs.modifier;
+    }
+    buffer->attachments.add(key);
+}
+
+SP<IBuffer> Aquamarine::IAllocator::takeFromPool(const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain) {
+    if (!swapchain || pool.empty())
+        return nullptr;
+
+    std::erase_if(pool, [](const SP<IBuffer>& b) { return b->attachments.get<CBufferPoolKey>()->stale(); });
+
+    const auto&                            SCANOUT_OUTPUT = swapchain->currentOptions().scanoutOutput;
+    std::optional<std::vector<SDRMFormat>> formats;
+    for (auto it = pool.begin(); it != pool.end(); ++it) {
+        // still held (or scanned out) by someone, e.g. an output that hasn't committed its new swapchain yet
+        if (it->strongRef() > 1 || (*it)->locked() || (*it)->lockedByBackend)
+            continue;
+
+        const auto KEY = (*it)->attachments.get<CBufferPoolKey>();
+        if (!KEY->matches(params, swapchain->backendImpl, SCANOUT_OUTPUT))
+            continue;
+
+        // the same formats a new buffer would pick its modifier from
+        if (!formats) {
+            if (params.cursor && params.scanout)
+                formats = swapchain->backendImpl->getCursorFormats();
+            else if (params.scanout && SCANOUT_OUTPUT && !params.multigpu)
+                formats = SCANOUT_OUTPUT->getRenderFormats();
+            else
+                formats = swapchain->backendImpl->getRenderFormats();
+        }
+
+        if (!KEY->supported(*formats))
+            continue;
+
+        auto buffer = *it;
+        pool.erase(it);
+
+        if (ledger)
+            ledger->stats.poolHits++;
+        if (auto accounting = buffer->attachments.get<CBufferAccounting>())
+            accounting->setOwner(swapchain);
+
+        return buffer;
+    }
+
+    return nullptr;
+}
+
+void Aquamarine::IAllocator::recycle(SP<IBuffer> buffer) {
+    // only buffers we know the origin and the size of can be handed out again
+    if (!buffer || !buffer->good() || !buffer->attachments.has<CBufferPoolKey>() || !buffer->attachments.has<CBufferAccounting>() ||
+        std::ranges::find(pool, buffer) != pool.end())
+        return;
+
+    pool.emplace_back(buffer);
+    buffer->attachments.get<CBufferAccounting>()->setOwner({});
+
+    trimPool(POOL_MAX_BYTES);
+}
+
+size_t Aquamarine::IAllocator::trimPool(uint64_t maxBytes) {
+    uint64_t bytes = pooledBytes();
+
+    size_t   freed = 0;
+    while (freed < pool.size() && bytes > maxBytes) {
+        bytes -= pool.at(freed)->attachments.get<CBufferAccounting>()->bytes;
+        freed++;
+    }
+
+    pool.erase(pool.begin(), pool.begin() + freed);
+    return freed;
+}
+
+size_t Aquamarine::IAllocator::pooledBuffers() {
+    return pool.size();
+}
+
+uint64_t Aquamarine::IAllocator::pooledBytes() {
+    uint64_t bytes = 0;
+    for (auto const& b : pool) {
+        bytes += b->attachments.get<CBufferAccounting>()->bytes;
+    }
+    return bytes;
+}
+
+SAllocatorLedger& Aquamarine::IAllocator::getLedger() {
+    if (!ledger)
+        ledger = makeShared<SAllocatorLedger>();
+
+    return *ledger;
+}
+
+void Aquamarine::IAllocator::track(SP<IBuffer> buffer, SP<CLegacySwapchain> swapchain, uint64_t bytes, uint64_t latencyNs) {
+    if (!buffer)
+        return;
+
+    auto& l = getLedger();
+
+    l.stats.allocations++;
+
+    size_t         bucket = 0;
+    const uint64_t US     = latencyNs / 1000;
+    while (bucket + 1 < SAllocatorStats::LATENCY_BUCKETS && US >= (SAllocatorStats::LATENCY_BUCKET_BASE_US << bucket)) {
+        bucket++;
+    }
+    l.stats.latency.at(bucket)++;
+
+    auto accounting    = makeShared<CBufferAccounting>();
+    accounting->ledger = ledger;
+    accounting->bytes  = bytes;
+    accounting->owner  = swapchain;
+
+    if (auto attrs = buffer->dmabuf(); attrs.success) {
+        accounting->format   = attrs.format;
+        accounting->modifier = attrs.modifier;
+    } else if (auto shm = buffer->shm(); shm.success) {
+        accounting->format   = shm.format;
+        accounting->modifier = DRM_FORMAT_MOD_LINEAR;
+    }
+
+    l.account(accounting->format, accounting->modifier, accounting->owner, bytes, true);
+    buffer->attachments.add(accounting);
+}
+
+void Aquamarine::IAllocator::trackFailure() {
+    getLedger().stats.failures++;
+}
+
+SAllocatorStats Aquamarine::IAllocator::stats() {
+    if (!ledger)
+        return {};
+
+    auto result = ledger->stats;
+
+    result.pooledBuffers = pool.size();
+    result.pooledBytes   = pooledBytes();
+
+    for (auto& o : result.owners) {
+        if (auto swapchain = o.swapchain.lock(); swapchain && swapchain->currentOptions().scanoutOutput)
+            o.output = swapchain->currentOptions().scanoutOutput->name;
+    }
+
+    return result;
+}
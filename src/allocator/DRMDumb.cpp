@@ -8,6 +8,7 @@
 #include <xf86drm.h>
 #include <xf86drmMode.h>
 #include <unistd.h>
+#include <chrono>
 #include <cstring>
 #include <sys/mman.h>
 #include "../backend/drm/Renderer.hpp"
@@ -107,7 +108,8 @@ void Aquamarine::CDRMDumbBuffer::endDataPtr() {
 }
 
 Aquamarine::CDRMDumbAllocator::~CDRMDumbAllocator() {
-    ; // nothing to do
+    // pooled buffers need the drm fd to free themselves
+    trimPool();
 }
 
 SP<CDRMDumbAllocator> Aquamarine::CDRMDumbAllocator::create(int drmfd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_) {
@@ -136,9 +138,19 @@ SP<CDRMDumbAllocator> Aquamarine::CDRMDumbAllocator::create(int drmfd_, Hyprutil
 }
 
 SP<IBuffer> Aquamarine::CDRMDumbAllocator::acquire(const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain_) {
-    auto buf = SP<IBuffer>(new CDRMDumbBuffer(params, self, swapchain_));
-    if (!buf->good())
+    if (auto pooled = takeFromPool(params, swapchain_)) {
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("DRM Dumb: Reusing a pooled buffer with size {}", params.size)));
+        return pooled;
+    }
+
+    const auto START = std::chrono::steady_clock::now();
+    auto       buf   = SP<CDRMDumbBuffer>(new CDRMDumbBuffer(params, self, swapchain_));
+    if (!buf->good()) {
+        trackFailure();
         return nullptr;
+    }
+    tagForPool(buf, params, swapchain_);
+    track(buf, swapchain_, buf->bufferLen, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - START).count());
     return buf;
 }
 
@@ -7,13 +7,76 @@
 #include "Shared.hpp"
 #include <xf86drm.h>
 #include <gbm.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cstring>
 #include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include "../backend/drm/Renderer.hpp"
 
 using namespace Aquamarine;
 using namespace Hyprutils::Memory;
 #define SP CSharedPointer
 
+// What a gbm bo gets created with, worked out by CGBMBuffer::plan on the backend's thread.
+// createBO fills in the bo, and keeps its logs for the backend's thread as well.
+struct Aquamarine::SGBMAllocation {
+    Hyprutils::Math::Vector2D                             size;
+    uint32_t                                              format = DRM_FORMAT_INVALID, flags = 0;
+    std::vector<uint64_t>                                 modifiers, fallbackModifiers; // fallbackModifiers are for multigpu with AQ_FORCE_LINEAR_BLIT
+    bool                                                  scanout = false, cursor = false, multigpu = false, forceLinearBlit = false;
+
+    gbm_bo*                                               bo        = nullptr;
+    uint64_t                                              modifier  = DRM_FORMAT_MOD_INVALID;
+    uint64_t                                              latencyNs = 0; // time spent in gbm
+    std::vector<std::pair<eBackendLogLevel, std::string>> logs;
+
+    SP<std::mutex>                                        deviceLock; // set if the bo comes from the allocator's async device
+};
+
+struct Aquamarine::CGBMAllocator::SAsyncJob {
+    // the worker only touches allocations (but not their deviceLock), until it sets finished. Then it posts notify, which is built on the backend's thread
+    std::vector<SGBMAllocation>    allocations;
+    std::thread                    thread;
+    std::atomic<bool>              finished = false;
+    std::function<void(void)>      notify;
+
+    SAllocatorBufferParams         params;
+    CWeakPointer<CLegacySwapchain> swapchain;
+    std::vector<SP<IBuffer>>       buffers; // taken from the pool
+    FAsyncBuffersCallback          done;
+};
+
+// what a dmabuf really takes up. Tiled and compressed layouts can be larger than stride * height
+static uint64_t dmabufBytes(const SDMABUFAttrs& attrs) {
+    uint64_t                               bytes = 0;
+    std::array<std::pair<dev_t, ino_t>, 4> seen  = {};
+    for (int i = 0; i < attrs.planes; ++i) {
+        const int FD = attrs.fds.at(i);
+
+        // every plane gets an fd of its own, but planes sharing a bo share its dmabuf, and with it the inode
+        struct stat st;
+        if (fstat(FD, &st) == 0) {
+            const auto ID = std::make_pair(st.st_dev, st.st_ino);
+            if (std::ranges::find(seen.begin(), seen.begin() + i, ID) != seen.begin() + i)
+                continue;
+            seen.at(i) = ID;
+        }
+
+        if (off_t size = lseek(FD, 0, SEEK_END); size > 0) {
+            lseek(FD, 0, SEEK_SET);
+            bytes += size;
+        } else
+            bytes += (uint64_t)attrs.strides.at(i) * (uint64_t)attrs.size.y;
+    }
+
+    return bytes;
+}
+
 static SDRMFormat guessFormatFrom(std::vector<SDRMFormat> formats, bool cursor, bool scanout) {
     if (formats.empty())
         return SDRMFormat{};
@@ -61,22 +124,26 @@ static SDRMFormat guessFormatFrom(std::vector<SDRMFormat> formats, bool cursor,
     return formats.at(0);
 }
 
-Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_,
-                                   Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain) : allocator(allocator_) {
-    if (!allocator)
-        return;
+// bos from the async device are shared with the workers creating new ones, everything else is ours alone
+static std::unique_lock<std::mutex> lockDevice(const SP<std::mutex>& lock) {
+    return lock ? std::unique_lock<std::mutex>(*lock) : std::unique_lock<std::mutex>{};
+}
 
-    attrs.size   = params.size;
-    attrs.format = params.format;
-    size         = attrs.size;
+bool Aquamarine::CGBMBuffer::plan(const SAllocatorBufferParams& params, CGBMAllocator* allocator, Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain,
+                                   SGBMAllocation& allocation) {
+    allocation.size     = params.size;
+    allocation.format   = params.format;
+    allocation.scanout  = params.scanout;
+    allocation.cursor   = params.cursor && params.scanout;
+    allocation.multigpu = params.multigpu && params.scanout;
 
-    const bool CURSOR           = params.cursor && params.scanout;
-    const bool MULTIGPU         = params.multigpu && params.scanout;
+    const bool CURSOR           = allocation.cursor;
+    const bool MULTIGPU         = allocation.multigpu;
     const bool EXPLICIT_SCANOUT = params.scanout && swapchain->currentOptions().scanoutOutput && !params.multigpu;
 
     TRACE(allocator->backend->log(AQ_LOG_TRACE,
-                                  std::format("GBM: Allocating a buffer: size {}, format {}, cursor: {}, multigpu: {}, scanout: {}", attrs.size, fourccToName(attrs.format), CURSOR,
-                                              MULTIGPU, params.scanout)));
+                                  std::format("GBM: Allocating a buffer: size {}, format {}, cursor: {}, multigpu: {}, scanout: {}", allocation.size,
+                                              fourccToName(allocation.format), CURSOR, MULTIGPU, params.scanout)));
 
     if (EXPLICIT_SCANOUT)
         TRACE(allocator->backend->log(
@@ -90,22 +157,22 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
 
     std::vector<uint64_t> explicitModifiers;
 
-    if (attrs.format == DRM_FORMAT_INVALID) {
-        attrs.format = guessFormatFrom(FORMATS, CURSOR, params.scanout).drmFormat;
-        if (attrs.format != DRM_FORMAT_INVALID)
-            allocator->backend->log(AQ_LOG_DEBUG, std::format("GBM: Automatically selected format {} for new GBM buffer", fourccToName(attrs.format)));
+    if (allocation.format == DRM_FORMAT_INVALID) {
+        allocation.format = guessFormatFrom(FORMATS, CURSOR, params.scanout).drmFormat;
+        if (allocation.format != DRM_FORMAT_INVALID)
+            allocator->backend->log(AQ_LOG_DEBUG, std::format("GBM: Automatically selected format {} for new GBM buffer", fourccToName(allocation.format)));
     }
 
-    if (attrs.format == DRM_FORMAT_INVALID) {
+    if (allocation.format == DRM_FORMAT_INVALID) {
         allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: no format found");
-        return;
+        return false;
     }
 
     bool foundFormat = false;
     // check if we can use modifiers. If the requested support has any explicit modifier
     // supported by the primary backend, we can.
     for (auto const& f : FORMATS) {
-        if (f.drmFormat != attrs.format)
+        if (f.drmFormat != allocation.format)
             continue;
 
         foundFormat = true;
@@ -135,13 +202,14 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
     }
 
     if (!foundFormat) {
-        allocator->backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to allocate a GBM buffer: format {} isn't supported by primary backend", fourccToName(attrs.format)));
-        bo = nullptr;
-        return;
+        allocator->backend->log(AQ_LOG_ERROR,
+                                std::format("GBM: Failed to allocate a GBM buffer: format {} isn't supported by primary backend", fourccToName(allocation.format)));
+        return false;
     }
 
     static const auto forceLinearBlit = !envExplicitlyDisabled("AQ_FORCE_LINEAR_BLIT");
-    auto const        oldMods         = explicitModifiers; // used in FORCE_LINEAR_BLIT case.
+    allocation.forceLinearBlit        = forceLinearBlit;
+    allocation.fallbackModifiers      = explicitModifiers; // used in FORCE_LINEAR_BLIT case.
     if (MULTIGPU && !forceLinearBlit) {
         // Try to use the linear format if available for cross-GPU compatibility.
         // However, Nvidia doesn't support linear, so this is a best-effort basis.
@@ -162,54 +230,71 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
         explicitModifiers = {DRM_FORMAT_MOD_LINEAR};
     }
 
-    uint32_t flags = GBM_BO_USE_RENDERING;
+    allocation.modifiers = std::move(explicitModifiers);
+
+    allocation.flags = GBM_BO_USE_RENDERING;
     if (params.scanout && !MULTIGPU)
-        flags |= GBM_BO_USE_SCANOUT;
+        allocation.flags |= GBM_BO_USE_SCANOUT;
+
+    return true;
+}
+
+void Aquamarine::CGBMBuffer::createBO(gbm_device* device, SGBMAllocation& allocation) {
+    // this may run on a worker thread, so no logging from here
+    const auto LOG = [&allocation](eBackendLogLevel level, std::string msg) { allocation.logs.emplace_back(level, std::move(msg)); };
 
-    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    const auto  START    = std::chrono::steady_clock::now();
+    const auto& SIZE     = allocation.size;
+    const auto& MODS     = allocation.modifiers;
+    const auto  FORMAT   = allocation.format;
+    gbm_bo*     bo       = nullptr;
+    uint64_t    modifier = DRM_FORMAT_MOD_INVALID;
 
-    if (explicitModifiers.empty()) {
-        allocator->backend->log(AQ_LOG_WARNING, "GBM: Using modifier-less allocation");
-        bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, flags);
+    if (MODS.empty()) {
+        LOG(AQ_LOG_WARNING, "GBM: Using modifier-less allocation");
+        bo = gbm_bo_create(device, SIZE.x, SIZE.y, FORMAT, allocation.flags);
     } else {
-        TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Using modifier-based allocation, modifiers: {}", explicitModifiers.size())));
-        for (auto const& mod : explicitModifiers) {
-            TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: | mod 0x{:x}", mod)));
+        if (isTrace()) {
+            LOG(AQ_LOG_TRACE, std::format("GBM: Using modifier-based allocation, modifiers: {}", MODS.size()));
+            for (auto const& mod : MODS) {
+                LOG(AQ_LOG_TRACE, std::format("GBM: | mod 0x{:x}", mod));
+            }
         }
-        bo = gbm_bo_create_with_modifiers2(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size(), flags);
+        bo = gbm_bo_create_with_modifiers2(device, SIZE.x, SIZE.y, FORMAT, MODS.data(), MODS.size(), allocation.flags);
 
-        if (!bo && CURSOR) {
+        if (!bo && allocation.cursor) {
             // allow non-renderable cursor buffer for nvidia
-            allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers and flags failed, falling back to modifiers without flags");
-            bo = gbm_bo_create_with_modifiers(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size());
+            LOG(AQ_LOG_ERROR, "GBM: Allocating with modifiers and flags failed, falling back to modifiers without flags");
+            bo = gbm_bo_create_with_modifiers(device, SIZE.x, SIZE.y, FORMAT, MODS.data(), MODS.size());
         }
 
-        bool useLinear = explicitModifiers.size() == 1 && explicitModifiers[0] == DRM_FORMAT_MOD_LINEAR;
+        bool useLinear = MODS.size() == 1 && MODS[0] == DRM_FORMAT_MOD_LINEAR;
         if (bo) {
             modifier = gbm_bo_get_modifier(bo);
             if (useLinear && modifier == DRM_FORMAT_MOD_INVALID)
                 modifier = DRM_FORMAT_MOD_LINEAR;
         } else {
             if (useLinear) {
-                flags |= GBM_BO_USE_LINEAR;
+                allocation.flags |= GBM_BO_USE_LINEAR;
                 modifier = DRM_FORMAT_MOD_LINEAR;
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to modifier-less allocation");
+                LOG(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to modifier-less allocation");
             } else
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to implicit");
-            bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, flags);
+                LOG(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to implicit");
+            bo = gbm_bo_create(device, SIZE.x, SIZE.y, FORMAT, allocation.flags);
         }
     }
 
-    if (MULTIGPU && forceLinearBlit) {
+    if (allocation.multigpu && allocation.forceLinearBlit) {
         // FIXME: most likely nvidia main gpu on multigpu
         if (!bo) {
-            if (oldMods.empty())
-                bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, GBM_BO_USE_RENDERING);
+            const auto& OLD_MODS = allocation.fallbackModifiers;
+            if (OLD_MODS.empty())
+                bo = gbm_bo_create(device, SIZE.x, SIZE.y, FORMAT, GBM_BO_USE_RENDERING);
             else
-                bo = gbm_bo_create_with_modifiers(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, oldMods.data(), oldMods.size());
+                bo = gbm_bo_create_with_modifiers(device, SIZE.x, SIZE.y, FORMAT, OLD_MODS.data(), OLD_MODS.size());
 
             if (!bo) {
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
+                LOG(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
                 return;
             }
 
@@ -218,25 +303,52 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
     }
 
     if (!bo) {
-        allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
+        LOG(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
+        return;
+    }
+
+    allocation.bo        = bo;
+    allocation.modifier  = modifier;
+    allocation.latencyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - START).count();
+}
+
+Aquamarine::CGBMBuffer::CGBMBuffer(SGBMAllocation& allocation, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_,
+                                   Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain) :
+    allocator(allocator_), deviceLock(allocation.deviceLock), bo(std::exchange(allocation.bo, nullptr)) {
+    attrs.size   = allocation.size;
+    attrs.format = allocation.format;
+    size         = attrs.size;
+
+    if (!allocator)
         return;
+
+    for (auto const& [level, msg] : allocation.logs) {
+        allocator->backend->log(level, msg);
     }
+    allocation.logs.clear();
 
-    attrs.planes   = gbm_bo_get_plane_count(bo);
-    attrs.modifier = modifier;
+    if (!bo)
+        return;
 
-    for (size_t i = 0; i < (size_t)attrs.planes; ++i) {
-        attrs.strides.at(i) = gbm_bo_get_stride_for_plane(bo, i);
-        attrs.offsets.at(i) = gbm_bo_get_offset(bo, i);
-        attrs.fds.at(i)     = gbm_bo_get_fd_for_plane(bo, i);
+    {
+        auto lock = lockDevice(deviceLock);
 
-        if (attrs.fds.at(i) < 0) {
-            allocator->backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to query fd for plane {}", i));
-            for (size_t j = 0; j < i; ++j) {
-                close(attrs.fds.at(j));
+        attrs.planes   = gbm_bo_get_plane_count(bo);
+        attrs.modifier = allocation.modifier;
+
+        for (size_t i = 0; i < (size_t)attrs.planes; ++i) {
+            attrs.strides.at(i) = gbm_bo_get_stride_for_plane(bo, i);
+            attrs.offsets.at(i) = gbm_bo_get_offset(bo, i);
+            attrs.fds.at(i)     = gbm_bo_get_fd_for_plane(bo, i);
+
+            if (attrs.fds.at(i) < 0) {
+                allocator->backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to query fd for plane {}", i));
+                for (size_t j = 0; j < i; ++j) {
+                    close(attrs.fds.at(j));
+                }
+                attrs.planes = 0;
+                return;
             }
-            attrs.planes = 0;
-            return;
         }
     }
 
@@ -250,7 +362,7 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
 
     free(modName);
 
-    if (params.scanout && !MULTIGPU && swapchain->backendImpl->type() == AQ_BACKEND_DRM) {
+    if (allocation.scanout && !allocation.multigpu && swapchain && swapchain->backendImpl->type() == AQ_BACKEND_DRM) {
         // clear the buffer using the DRM renderer to avoid uninitialized mem
         auto impl = (CDRMBackend*)swapchain->backendImpl.get();
         if (impl->rendererState.renderer)
@@ -265,6 +377,7 @@ Aquamarine::CGBMBuffer::~CGBMBuffer() {
 
     events.destroy.emit();
     if (bo) {
+        auto lock = lockDevice(deviceLock);
         if (gboMapping)
             gbm_bo_unmap(bo, gboMapping); // FIXME: is it needed before destroy?
         gbm_bo_destroy(bo);
@@ -299,37 +412,49 @@ std::tuple<uint8_t*, uint32_t, size_t> Aquamarine::CGBMBuffer::beginDataPtr(uint
     uint32_t stride = 0;
     if (boBuffer)
         allocator->backend->log(AQ_LOG_ERROR, "beginDataPtr is called a second time without calling endDataPtr first. Returning old mapping");
-    else
-        boBuffer = gbm_bo_map(bo, 0, 0, attrs.size.x, attrs.size.y, flags, &stride, &gboMapping);
+    else {
+        auto lock = lockDevice(deviceLock);
+        boBuffer  = gbm_bo_map(bo, 0, 0, attrs.size.x, attrs.size.y, flags, &stride, &gboMapping);
+    }
 
     return {(uint8_t*)boBuffer, attrs.format, stride * attrs.size.y};
 }
 
 void Aquamarine::CGBMBuffer::endDataPtr() {
     if (gboMapping) {
+        auto lock = lockDevice(deviceLock);
         gbm_bo_unmap(bo, gboMapping);
         gboMapping = nullptr;
         boBuffer   = nullptr;
     }
 }
 
-void CGBMAllocator::destroyBuffers() {
-    for (auto& buf : buffers) {
-        buf.reset();
+CGBMAllocator::~CGBMAllocator() {
+    // bos being created in the background, and pooled ones, have to go before the device does
+    for (auto const& job : asyncJobs) {
+        if (job->thread.joinable())
+            job->thread.join();
+
+        for (auto& a : job->allocations) {
+            if (a.bo)
+                gbm_bo_destroy(a.bo);
+        }
     }
-}
+    asyncJobs.clear();
 
-CGBMAllocator::~CGBMAllocator() {
-    if (!gbmDevice)
-        return;
+    trimPool();
 
-    int fd = gbm_device_get_fd(gbmDevice);
-    gbm_device_destroy(gbmDevice);
+    // both devices own their fd
+    for (auto device : {asyncDevice, gbmDevice}) {
+        if (!device)
+            continue;
 
-    if (fd < 0)
-        return;
+        int fd = gbm_device_get_fd(device);
+        gbm_device_destroy(device);
 
-    close(fd);
+        if (fd >= 0)
+            close(fd);
+    }
 }
 
 SP<CGBMAllocator> Aquamarine::CGBMAllocator::create(int drmfd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_) {
@@ -371,18 +496,163 @@ SP<IBuffer> Aquamarine::CGBMAllocator::acquire(const SAllocatorBufferParams& par
         return nullptr;
     }
 
-    auto newBuffer = SP<CGBMBuffer>(new CGBMBuffer(params, self, swapchain_));
+    if (auto pooled = takeFromPool(params, swapchain_)) {
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Reusing a pooled buffer with size {} and format {}", params.size, fourccToName(pooled->dmabuf().format))));
+        return pooled;
+    }
+
+    SGBMAllocation allocation;
+    if (CGBMBuffer::plan(params, this, swapchain_, allocation))
+        CGBMBuffer::createBO(gbmDevice, allocation);
+
+    auto newBuffer = SP<CGBMBuffer>(new CGBMBuffer(allocation, self, swapchain_));
 
     if (!newBuffer->good()) {
         backend->log(AQ_LOG_ERROR, std::format("Couldn't allocate a gbm buffer with size {} and format {}", params.size, fourccToName(params.format)));
+        trackFailure();
         return nullptr;
     }
 
-    buffers.emplace_back(newBuffer);
-    std::erase_if(buffers, [](const auto& b) { return b.expired(); });
+    tagForPool(newBuffer, params, swapchain_);
+    track(newBuffer, swapchain_, dmabufBytes(newBuffer->attrs), allocation.latencyNs);
     return newBuffer;
 }
 
+bool Aquamarine::CGBMAllocator::openAsyncDevice() {
+    if (asyncDevice)
+        return true;
+
+    // a gbm device of its own, on its own fd, so that the workers never touch the one the renderer's EGL display sits on
+    int fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (fd_ < 0) {
+        backend->log(AQ_LOG_ERROR, std::format("GBM: Couldn't dup the drm fd for background allocations: {}", strerror(errno)));
+        return false;
+    }
+
+    asyncDevice = gbm_create_device(fd_);
+    if (!asyncDevice) {
+        backend->log(AQ_LOG_ERROR, "GBM: Couldn't create a gbm device for background allocations");
+        close(fd_);
+        return false;
+    }
+
+    asyncDeviceLock = makeShared<std::mutex>();
+    return true;
+}
+
+void Aquamarine::CGBMAllocator::acquireAsync(const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain_, size_t count, FAsyncBuffersCallback done) {
+    if (params.size.x < 1 || params.size.y < 1 || !swapchain_) {
+        done({});
+        return;
+    }
+
+    // without a device for the workers, allocate right here
+    if (!openAsyncDevice()) {
+        IAllocator::acquireAsync(params, swapchain_, count, std::move(done));
+        return;
+    }
+
+    auto job       = std::make_unique<SAsyncJob>();
+    job->params    = params;
+    job->swapchain = swapchain_;
+    job->done      = std::move(done);
+
+    // recycled buffers are ready as they are
+    while (job->buffers.size() < count) {
+        auto pooled = takeFromPool(params, swapchain_);
+        if (!pooled)
+            break;
+        job->buffers.emplace_back(pooled);
+    }
+
+    if (job->buffers.size() == count) {
+        job->done(std::move(job->buffers));
+        return;
+    }
+
+    // planning reads the backend's formats, so it has to happen here
+    job->allocations.resize(count - job->buffers.size());
+    for (auto& a : job->allocations) {
+        a.deviceLock = asyncDeviceLock;
+        if (!CGBMBuffer::plan(params, this, swapchain_, a)) {
+            for (auto const& b : job->buffers) {
+                recycle(b);
+            }
+            job->done({});
+            return;
+        }
+    }
+
+    TRACE(backend->log(AQ_LOG_TRACE,
+                       std::format("GBM: Allocating {} buffers with size {} in the background, {} from the pool", count, params.size, job->buffers.size())));
+
+    job->notify = [weak = self]() {
+        if (weak)
+            weak->collectAsyncJobs(false);
+    };
+
+    // the backend can go away before us, and with it its task queue. Then notify stays in the job, and goes when we do
+    job->thread = std::thread([job = job.get(), device = asyncDevice, lock = asyncDeviceLock.get(), gate = backend->getTaskGate()]() {
+        for (auto& a : job->allocations) {
+            std::lock_guard<std::mutex> lg(*lock);
+            CGBMBuffer::createBO(device, a);
+            if (!a.bo)
+                break;
+        }
+        job->finished.store(true, std::memory_order_release);
+        gate->post(job->notify);
+    });
+
+    asyncJobs.emplace_back(std::move(job));
+}
+
+void Aquamarine::CGBMAllocator::flushAsync() {
+    collectAsyncJobs(true);
+}
+
+void Aquamarine::CGBMAllocator::collectAsyncJobs(bool wait) {
+    // callbacks may start new jobs, so take the finished ones out first
+    std::vector<std::unique_ptr<SAsyncJob>> finished;
+    std::erase_if(asyncJobs, [&finished, wait](auto& job) {
+        if (!wait && !job->finished.load(std::memory_order_acquire))
+            return false;
+        finished.emplace_back(std::move(job));
+        return true;
+    });
+
+    for (auto const& job : finished) {
+        job->thread.join();
+
+        // the rest is what acquire() does after the bo exists: wrapping it, and clearing it with the renderer
+        auto                     swapchain = job->swapchain.lock();
+        std::vector<SP<IBuffer>> result    = std::move(job->buffers);
+        bool                     ok        = true;
+        for (auto& a : job->allocations) {
+            auto buffer = SP<CGBMBuffer>(new CGBMBuffer(a, self, swapchain));
+            if (!buffer->good()) {
+                trackFailure();
+                ok = false;
+                continue;
+            }
+
+            tagForPool(buffer, job->params, swapchain);
+            track(buffer, swapchain, dmabufBytes(buffer->attrs), a.latencyNs);
+            result.emplace_back(buffer);
+        }
+
+        if (!ok) {
+            backend->log(AQ_LOG_ERROR, std::format("Couldn't allocate gbm buffers with size {} and format {} in the background", job->params.size,
+                                                   fourccToName(job->params.format)));
+            for (auto const& b : result) {
+                recycle(b);
+            }
+            result.clear();
+        }
+
+        job->done(std::move(result));
+    }
+}
+
 Hyprutils::Memory::CSharedPointer<CBackend> Aquamarine::CGBMAllocator::getBackend() {
     return backend.lock();
 }
@@ -0,0 +1,252 @@
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include "FormatUtils.hpp"
+#include "Shared.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sys/mman.h>
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+#define WP CWeakPointer
+
+// rows start on a cache line
+constexpr uint32_t SHM_STRIDE_ALIGN = 64;
+
+// the default hugepage size on x86_64 and aarch64, hugetlb mappings have to be a multiple of it
+constexpr size_t SHM_HUGEPAGE_SIZE = 2 * 1024 * 1024;
+
+static uint32_t bytesPerPixel(uint32_t format) {
+    switch (format) {
+        case DRM_FORMAT_RGB565:
+        case DRM_FORMAT_BGR565: return 2;
+        case DRM_FORMAT_RGB888:
+        case DRM_FORMAT_BGR888: return 3;
+        case DRM_FORMAT_XRGB8888:
+        case DRM_FORMAT_ARGB8888:
+        case DRM_FORMAT_XBGR8888:
+        case DRM_FORMAT_ABGR8888:
+        case DRM_FORMAT_RGBX8888:
+        case DRM_FORMAT_RGBA8888:
+        case DRM_FORMAT_BGRX8888:
+        case DRM_FORMAT_BGRA8888:
+        case DRM_FORMAT_XRGB2101010:
+        case DRM_FORMAT_ARGB2101010:
+        case DRM_FORMAT_XBGR2101010:
+        case DRM_FORMAT_ABGR2101010: return 4;
+        case DRM_FORMAT_XBGR16161616:
+        case DRM_FORMAT_ABGR16161616:
+        case DRM_FORMAT_XBGR16161616F:
+        case DRM_FORMAT_ABGR16161616F: return 8;
+        default: return 0;
+    }
+}
+
+// picks like the gbm allocator does for an unset format, among the formats we know the layout of. 10bpp is left out, cpu renderers want 8bpc
+static uint32_t guessFormatFrom(const std::vector<SDRMFormat>& formats, bool scanout) {
+    const auto FIND = [&formats](uint32_t a, uint32_t b) {
+        auto it = std::ranges::find_if(formats, [a, b](const auto& f) { return f.drmFormat == a || f.drmFormat == b; });
+        return it == formats.end() ? DRM_FORMAT_INVALID : it->drmFormat;
+    };
+
+    if (!scanout) {
+        if (const auto FORMAT = FIND(DRM_FORMAT_ARGB8888, DRM_FORMAT_ABGR8888); FORMAT != DRM_FORMAT_INVALID)
+            return FORMAT;
+    }
+
+    if (const auto FORMAT = FIND(DRM_FORMAT_XRGB8888, DRM_FORMAT_XBGR8888); FORMAT != DRM_FORMAT_INVALID)
+        return FORMAT;
+
+    if (auto it = std::ranges::find_if(formats, [](const auto& f) { return bytesPerPixel(f.drmFormat) != 0; }); it != formats.end())
+        return it->drmFormat;
+
+    return DRM_FORMAT_XRGB8888;
+}
+
+Aquamarine::CSHMBuffer::CSHMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator_,
+                                   Hyprutils::Memory::CSharedPointer<CLegacySwapchain> swapchain, bool hugepages) : allocator(allocator_) {
+    auto format = params.format;
+    if (format == DRM_FORMAT_INVALID) {
+        format = guessFormatFrom(swapchain && swapchain->backendImpl ? swapchain->backendImpl->getRenderFormats() : std::vector<SDRMFormat>{}, params.scanout);
+        allocator->backend->log(AQ_LOG_DEBUG, std::format("SHM: Automatically selected format {} for new SHM buffer", fourccToName(format)));
+    }
+
+    const auto BPP = bytesPerPixel(format);
+    if (!BPP) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("SHM: Cannot allocate a buffer with unsupported format {}", fourccToName(format)));
+        return;
+    }
+
+    if (params.size.x < 1 || params.size.y < 1) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("SHM: Cannot allocate a buffer with invalid size {}", params.size));
+        return;
+    }
+
+    const uint32_t STRIDE = (((uint32_t)params.size.x * BPP) + SHM_STRIDE_ALIGN - 1) & ~(SHM_STRIDE_ALIGN - 1);
+    const size_t   LEN    = (size_t)STRIDE * (size_t)params.size.y;
+
+    // regular pages if there are no hugepages to be had, the allocator sees huge is unset
+    if ((!hugepages || !map((LEN + SHM_HUGEPAGE_SIZE - 1) & ~(SHM_HUGEPAGE_SIZE - 1), true)) && !map(LEN, false)) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("SHM: Failed to allocate a buffer with size {}: {}", params.size, strerror(errno)));
+        return;
+    }
+
+    // memfds start out zeroed, no need to clear
+
+    size = params.size;
+
+    attrs.format  = format;
+    attrs.size    = params.size;
+    attrs.stride  = STRIDE;
+    attrs.offset  = 0;
+    attrs.success = true;
+
+    allocator->backend->log(AQ_LOG_DEBUG,
+                            std::format("SHM: Allocated a new buffer with fd {}, size {}, stride {}, format {}{}", attrs.fd, attrs.size, attrs.stride, fourccToName(attrs.format),
+                                        huge ? " (hugepages)" : ""));
+}
+
+bool Aquamarine::CSHMBuffer::map(size_t len, bool hugepages) {
+    unsigned int flags = MFD_CLOEXEC | MFD_ALLOW_SEALING;
+    if (hugepages) {
+#ifdef MFD_HUGETLB
+        flags |= MFD_HUGETLB;
+#else
+        return false;
+#endif
+    }
+
+    int fd = memfd_create("aquamarine-shm", flags);
+    if (fd < 0)
+        return false;
+
+    int ret;
+    do {
+        ret = ftruncate(fd, len);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0) {
+        close(fd);
+        return false;
+    }
+
+    // whoever we share this with can't pull the memory from under our mapping
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL);
+
+    auto mapped = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    data     = (uint8_t*)mapped;
+    dataLen  = len;
+    huge     = hugepages;
+    attrs.fd = fd;
+    return true;
+}
+
+Aquamarine::CSHMBuffer::~CSHMBuffer() {
+    events.destroy.emit();
+
+    // pooled buffers can outlive the allocator
+    if (auto a = allocator.lock(); a && a->backend)
+        TRACE(a->backend->log(AQ_LOG_TRACE, std::format("SHM: dropping buffer {}", attrs.fd)));
+
+    if (data)
+        munmap(data, dataLen);
+
+    if (attrs.fd >= 0)
+        close(attrs.fd);
+}
+
+eBufferCapability Aquamarine::CSHMBuffer::caps() {
+    return eBufferCapability::BUFFER_CAPABILITY_DATAPTR;
+}
+
+eBufferType Aquamarine::CSHMBuffer::type() {
+    return eBufferType::BUFFER_TYPE_SHM;
+}
+
+void Aquamarine::CSHMBuffer::update(const Hyprutils::Math::CRegion& damage) {
+    ; // nothing to do
+}
+
+bool Aquamarine::CSHMBuffer::isSynchronous() {
+    return true;
+}
+
+bool Aquamarine::CSHMBuffer::good() {
+    return attrs.success && data;
+}
+
+SSHMAttrs Aquamarine::CSHMBuffer::shm() {
+    return attrs;
+}
+
+std::tuple<uint8_t*, uint32_t, size_t> Aquamarine::CSHMBuffer::beginDataPtr(uint32_t flags) {
+    return {data, attrs.format, (size_t)attrs.stride * (size_t)attrs.size.y};
+}
+
+void Aquamarine::CSHMBuffer::endDataPtr() {
+    ; // nothing to do
+}
+
+Aquamarine::CSHMAllocator::~CSHMAllocator() {
+    // pooled buffers log through us when they're freed
+    trimPool();
+}
+
+SP<CSHMAllocator> Aquamarine::CSHMAllocator::create(Hyprutils::Memory::CWeakPointer<CBackend> backend_) {
+    auto a  = SP<CSHMAllocator>(new CSHMAllocator(backend_));
+    a->self = a;
+
+    backend_->log(AQ_LOG_DEBUG, std::format("SHM: created a shm allocator{}", a->hugepages ? " with hugepages" : ""));
+
+    return a;
+}
+
+SP<IBuffer> Aquamarine::CSHMAllocator::acquire(const SAllocatorBufferParams& params, SP<CLegacySwapchain> swapchain_) {
+    if (auto pooled = takeFromPool(params, swapchain_)) {
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("SHM: Reusing a pooled buffer with size {}", params.size)));
+        return pooled;
+    }
+
+    const auto START = std::chrono::steady_clock::now();
+    auto       buf   = SP<CSHMBuffer>(new CSHMBuffer(params, self, swapchain_, hugepages));
+    if (!buf->good()) {
+        trackFailure();
+        return nullptr;
+    }
+
+    if (hugepages && !buf->huge) {
+        // no hugepages reserved, most likely. Don't try again for every buffer
+        backend->log(AQ_LOG_WARNING, "SHM: Failed to allocate a buffer from hugepages, falling back to regular pages");
+        hugepages = false;
+    }
+
+    tagForPool(buf, params, swapchain_);
+    track(buf, swapchain_, buf->dataLen, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - START).count());
+    return buf;
+}
+
+SP<CBackend> Aquamarine::CSHMAllocator::getBackend() {
+    return backend.lock();
+}
+
+int Aquamarine::CSHMAllocator::drmFD() {
+    return -1;
+}
+
+eAllocatorType Aquamarine::CSHMAllocator::type() {
+    return eAllocatorType::AQ_ALLOCATOR_TYPE_SHM;
+}
+
+Aquamarine::CSHMAllocator::CSHMAllocator(Hyprutils::Memory::CWeakPointer<CBackend> backend_) : backend(backend_), hugepages(envEnabled("AQ_SHM_HUGEPAGES")) {
+    ; // nothing to do
+}
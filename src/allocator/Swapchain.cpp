@@ -2,6 +2,7 @@
 #include <aquamarine/allocator/Swapchain.hpp>
 #include <aquamarine/backend/Backend.hpp>
 #include "FormatUtils.hpp"
+#include "Shared.hpp"
 
 using namespace Aquamarine;
 using namespace Hyprutils::Memory;
@@ -26,7 +27,12 @@ bool Aquamarine::CLegacySwapchain::reconfigure(const SSwapchainOptions& options_
     if (options_.size == Vector2D{} || options_.length == 0) {
         // clear the swapchain
         allocator->getBackend()->log(AQ_LOG_DEBUG, "Swapchain: Clearing");
+        for (auto const& b : buffers) {
+            allocator->recycle(b);
+        }
         buffers.clear();
+        history.clear();
+        damageRing.clear();
         options = options_;
         return true;
     }
@@ -52,7 +58,7 @@ bool Aquamarine::CLegacySwapchain::reconfigure(const SSwapchainOptions& options_
 
     options = options_;
     if (options.format == DRM_FORMAT_INVALID)
-        options.format = buffers.at(0)->dmabuf().format;
+        options.format = buffers.at(0)->type() == BUFFER_TYPE_SHM ? buffers.at(0)->shm().format : buffers.at(0)->dmabuf().format;
 
     allocator->getBackend()->log(AQ_LOG_DEBUG,
                                  std::format("Swapchain: Reconfigured a swapchain to {} {} of length {}", options.size, fourccToName(options.format), options.length));
@@ -63,41 +69,162 @@ SP<IBuffer> Aquamarine::CLegacySwapchain::next(int* age) {
     if (!allocator || options.length <= 0)
         return nullptr;
 
-    lastAcquired = (lastAcquired + 1) % options.length;
+    if (buffers.empty())
+        return nullptr;
+
+    // take the buffer that was presented the longest ago (never presented ones first, in acquire order),
+    // skipping the ones the backend is still scanning out or a consumer still holds.
+    // If all of them are busy, fall back to the oldest one regardless.
+    const auto OLDER = [this](size_t a, size_t b) {
+        return history[a].lastPresented != history[b].lastPresented ? history[a].lastPresented < history[b].lastPresented :
+                                                                      history[a].lastAcquired < history[b].lastAcquired;
+    };
+
+    int best = -1, oldest = 0;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        if (OLDER(i, oldest))
+            oldest = i;
+
+        if (buffers[i]->lockedByBackend || buffers[i]->locked())
+            continue;
+
+        if (best < 0 || OLDER(i, best))
+            best = i;
+    }
+
+    if (best < 0) {
+        TRACE(allocator->getBackend()->log(AQ_LOG_TRACE, "Swapchain: all buffers are busy, reusing the oldest one"));
+        best = oldest;
+    }
+
+    lastAcquired                       = best;
+    history[lastAcquired].lastAcquired = ++acquireSeq;
 
     if (age)
-        *age = options.length; // we always just rotate
+        *age = history[lastAcquired].lastPresented ? (int)(presentSeq - history[lastAcquired].lastPresented + 1) : 0;
 
     return buffers.at(lastAcquired);
 }
 
+static SAllocatorBufferParams bufferParamsFor(const SSwapchainOptions& options) {
+    return SAllocatorBufferParams{.size = options.size, .format = options.format, .scanout = options.scanout, .cursor = options.cursor, .multigpu = options.multigpu};
+}
+
+// whether two configurations get the same buffers
+static bool sameBuffers(const SSwapchainOptions& a, const SSwapchainOptions& b) {
+    return a.length == b.length && a.size == b.size && a.format == b.format && a.scanout == b.scanout && a.cursor == b.cursor && a.multigpu == b.multigpu;
+}
+
 bool Aquamarine::CLegacySwapchain::fullReconfigure(const SSwapchainOptions& options_) {
     std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> bfs;
+    if (takePreallocated(options_, bfs))
+        allocator->getBackend()->log(AQ_LOG_DEBUG, std::format("Swapchain: Using {} preallocated buffers", bfs.size()));
+
     bfs.reserve(options_.length);
 
-    for (size_t i = 0; i < options_.length; ++i) {
-        auto buf = allocator->acquire(
-            SAllocatorBufferParams{.size = options_.size, .format = options_.format, .scanout = options_.scanout, .cursor = options_.cursor, .multigpu = options_.multigpu},
-            self.lock());
+    while (bfs.size() < options_.length) {
+        auto buf = allocator->acquire(bufferParamsFor(options_), self.lock());
         if (!buf) {
             allocator->getBackend()->log(AQ_LOG_ERROR, "Swapchain: Failed acquiring a buffer");
+            for (auto const& b : bfs) {
+                allocator->recycle(b);
+            }
             return false;
         }
         bfs.emplace_back(buf);
     }
 
+    for (auto const& b : buffers) {
+        allocator->recycle(b);
+    }
+
     buffers = std::move(bfs);
+    history.assign(buffers.size(), SBufferHistory{});
+    damageRing.clear();
+
+    return true;
+}
+
+bool Aquamarine::CLegacySwapchain::preallocate(const SSwapchainOptions& options_) {
+    if (!allocator || options_.size == Vector2D{} || options_.length == 0)
+        return false;
+
+    // already there, or on its way
+    if ((sameBuffers(options_, options) && buffers.size() == options.length) || (sameBuffers(options_, prepared.options) && (prepared.inFlight || !prepared.buffers.empty())))
+        return false;
+
+    dropPreallocated();
+
+    prepared.options  = options_;
+    prepared.inFlight = true;
+
+    allocator->getBackend()->log(AQ_LOG_DEBUG, std::format("Swapchain: Preallocating {} {} buffers of size {}", options_.length, fourccToName(options_.format), options_.size));
+
+    allocator->acquireAsync(bufferParamsFor(options_), self.lock(), options_.length, [weak = self, seq = prepared.seq](std::vector<SP<IBuffer>> bfs) {
+        auto swapchain = weak.lock();
+        if (!swapchain)
+            return;
+
+        if (swapchain->prepared.seq != seq) {
+            // superseded, someone else might have a use for them
+            for (auto const& b : bfs) {
+                swapchain->allocator->recycle(b);
+            }
+            return;
+        }
+
+        if (bfs.empty())
+            swapchain->allocator->getBackend()->log(AQ_LOG_ERROR, "Swapchain: Failed preallocating buffers");
+
+        swapchain->prepared.inFlight = false;
+        swapchain->prepared.buffers  = std::move(bfs);
+    });
+
+    return true;
+}
+
+bool Aquamarine::CLegacySwapchain::preallocated(const SSwapchainOptions& options_) {
+    return sameBuffers(options_, prepared.options) && !prepared.inFlight && prepared.buffers.size() == options_.length;
+}
+
+bool Aquamarine::CLegacySwapchain::takePreallocated(const SSwapchainOptions& options_, std::vector<SP<IBuffer>>& out) {
+    if (!sameBuffers(options_, prepared.options))
+        return false;
+
+    // still being allocated. Waiting on the workers would hold up the commit, allocate them here instead. Late ones are superseded and go to the pool
+    if (prepared.inFlight) {
+        dropPreallocated();
+        return false;
+    }
 
+    if (prepared.buffers.size() != options_.length)
+        return false;
+
+    out = std::move(prepared.buffers);
+    dropPreallocated();
     return true;
 }
 
+void Aquamarine::CLegacySwapchain::dropPreallocated() {
+    for (auto const& b : prepared.buffers) {
+        allocator->recycle(b);
+    }
+
+    prepared.buffers.clear();
+    prepared.options  = {};
+    prepared.inFlight = false;
+    prepared.seq++;
+}
+
 bool Aquamarine::CLegacySwapchain::resize(size_t newSize) {
     if (newSize == buffers.size())
         return true;
 
     if (newSize < buffers.size()) {
         while (buffers.size() > newSize) {
+            allocator->recycle(buffers.back());
             buffers.pop_back();
+            history.pop_back();
         }
     } else {
         while (buffers.size() < newSize) {
@@ -108,9 +235,12 @@ bool Aquamarine::CLegacySwapchain::resize(size_t newSize) {
                 return false;
             }
             buffers.emplace_back(buf);
+            history.emplace_back();
         }
     }
 
+    lastAcquired = std::min<int>(lastAcquired, buffers.size() - 1);
+
     return true;
 }
 
@@ -123,15 +253,64 @@ const SSwapchainOptions& Aquamarine::CLegacySwapchain::currentOptions() {
 }
 
 void Aquamarine::CLegacySwapchain::rollback() {
-    lastAcquired--;
-    if (lastAcquired < 0)
-        lastAcquired = options.length - 1;
+    // hand the last acquired buffer out again next time, unless an older one frees up
+    if (lastAcquired >= 0 && (size_t)lastAcquired < history.size())
+        history[lastAcquired].lastAcquired = 0;
+}
+
+CRegion Aquamarine::CLegacySwapchain::damageForAge(int age) {
+    return damageRing.accumulate(age, options.size);
+}
+
+void Aquamarine::CLegacySwapchain::presented(SP<IBuffer> buffer, const CRegion& damage) {
+    // a buffer from outside still puts another frame on screen, so ours all get older
+    ++presentSeq;
+    damageRing.push(damage);
+
+    auto it = std::ranges::find(buffers, buffer);
+    if (it != buffers.end())
+        history[it - buffers.begin()].lastPresented = presentSeq;
 }
 
 SP<IAllocator> Aquamarine::CLegacySwapchain::getAllocator() {
     return allocator;
 }
 
+CRegion Aquamarine::ISwapchain::damageForAge(int age) {
+    const auto& SIZE = currentOptions().size;
+    return CRegion{0, 0, SIZE.x, SIZE.y};
+}
+
+void Aquamarine::ISwapchain::presented(SP<IBuffer> buffer, const CRegion& damage) {
+    ; // untracked
+}
+
+void Aquamarine::CSwapchainDamageRing::push(const CRegion& damage) {
+    head         = (head + 1) % HISTORY;
+    frames[head] = damage;
+    count        = std::min(count + 1, HISTORY);
+}
+
+CRegion Aquamarine::CSwapchainDamageRing::accumulate(int age, const Vector2D& size) const {
+    // age 1 means the buffer holds the last presented frame, so it's missing nothing.
+    if (age <= 0 || (size_t)age - 1 > count)
+        return CRegion{0, 0, size.x, size.y};
+
+    CRegion result;
+    for (size_t i = 0; i < (size_t)age - 1; ++i) {
+        result.add(frames[(head + HISTORY - i) % HISTORY]);
+    }
+
+    return result;
+}
+
+void Aquamarine::CSwapchainDamageRing::clear() {
+    count = 0;
+    for (auto& f : frames) {
+        f.clear();
+    }
+}
+
 Aquamarine::ISwapchain::~ISwapchain() {
     ; // nothing to do
 }
\ No newline at end of file
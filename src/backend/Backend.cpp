@@ -5,8 +5,14 @@
 #include <aquamarine/backend/Null.hpp>
 #include <aquamarine/backend/Tab.hpp>
 #include <aquamarine/allocator/GBM.hpp>
+#include <aquamarine/allocator/SHM.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <ranges>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <ctime>
 #include <cstring>
@@ -22,19 +28,6 @@ using namespace Aquamarine;
 
 #define TIMESPEC_NSEC_PER_SEC 1000000000LL
 
-static void timespecAddNs(timespec* pTimespec, int64_t delta) {
-    int delta_ns_low = delta % TIMESPEC_NSEC_PER_SEC;
-    int delta_s_high = delta / TIMESPEC_NSEC_PER_SEC;
-
-    pTimespec->tv_sec += delta_s_high;
-
-    pTimespec->tv_nsec += (long)delta_ns_low;
-    if (pTimespec->tv_nsec >= TIMESPEC_NSEC_PER_SEC) {
-        pTimespec->tv_nsec -= TIMESPEC_NSEC_PER_SEC;
-        ++pTimespec->tv_sec;
-    }
-}
-
 static const char* backendTypeToName(eBackendType type) {
     switch (type) {
         case AQ_BACKEND_DRM: return "drm";
@@ -46,7 +39,7 @@ static const char* backendTypeToName(eBackendType type) {
     return "invalid";
 }
 
-Aquamarine::CBackend::CBackend() {
+Aquamarine::CBackend::CBackend() : taskGate(std::make_shared<CTaskGate>(&tasks)) {
     ;
 }
 
@@ -109,13 +102,25 @@ Hyprutils::Memory::CSharedPointer<CBackend> Aquamarine::CBackend::create(const s
     }
 
     // create a timerfd for idle events
-    backend->idle.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    backend->idle.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    // and one for timers
+    backend->timers.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+    // created upfront so that wakeLoop() can be called from other threads at any point
+    backend->loop.wakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
 
     return backend;
 }
 
 Aquamarine::CBackend::~CBackend() {
-    ;
+    // members go away in reverse order, tasks before primaryAllocator. Allocator workers still running must not post into it
+    taskGate->close();
+
+    for (auto const& fd : {idle.fd, timers.fd, loop.epollFD, loop.wakeFD}) {
+        if (fd >= 0)
+            close(fd);
+    }
 }
 
 bool Aquamarine::CBackend::start() {
@@ -158,7 +163,6 @@ bool Aquamarine::CBackend::start() {
         return failed;
     });
 
-    // TODO: obviously change this when (if) we add different allocators.
     for (auto const& b : implementations) {
         if (b->drmFD() >= 0) {
             auto fd = reopenDRMNode(b->drmFD());
@@ -172,6 +176,12 @@ bool Aquamarine::CBackend::start() {
         }
     }
 
+    // no gpu to allocate from, render on the cpu
+    if (!primaryAllocator && std::ranges::none_of(implementations, [](const auto& i) { return i->drmFD() >= 0; })) {
+        log(AQ_LOG_DEBUG, "No drm device for a GBM allocator, falling back to a SHM allocator");
+        primaryAllocator = CSHMAllocator::create(self);
+    }
+
     if (!primaryAllocator && (implementations.empty() || (implementations.at(0)->type() != AQ_BACKEND_NULL && implementations.at(0)->type() != AQ_BACKEND_TAB))) {
         log(AQ_LOG_CRITICAL, "Cannot open backend: no allocator available");
         return false;
@@ -213,6 +223,12 @@ std::vector<Hyprutils::Memory::CSharedPointer<SPollFD>> Aquamarine::CBackend::ge
     log(AQ_LOG_DEBUG, std::format("backend: poll fd {} for idle", idle.fd));
     result.emplace_back(makeShared<SPollFD>(idle.fd, [this]() { dispatchIdle(); }));
 
+    log(AQ_LOG_DEBUG, std::format("backend: poll fd {} for timers", timers.fd));
+    result.emplace_back(makeShared<SPollFD>(timers.fd, [this]() { dispatchTimers(); }));
+
+    log(AQ_LOG_DEBUG, std::format("backend: poll fd {} for posted tasks", tasks.fd()));
+    result.emplace_back(makeShared<SPollFD>(tasks.fd(), [this]() { tasks.drain(); }));
+
     return result;
 }
 
@@ -261,39 +277,297 @@ const std::vector<SP<IBackendImplementation>>& Aquamarine::CBackend::getImplemen
     return implementations;
 }
 
+// pointer identity is all that matters for idle callbacks
+static size_t idleHash(std::function<void(void)>* key) {
+    const auto V = (uintptr_t)key;
+    return (size_t)((V >> 4) ^ (V >> 16));
+}
+
+Aquamarine::CBackend::SIdleSlot* Aquamarine::CBackend::findIdleSlot(std::function<void(void)>* key) {
+    if (idle.slots.empty())
+        return nullptr;
+
+    const size_t MASK = idle.slots.size() - 1;
+    for (size_t i = idleHash(key) & MASK;; i = (i + 1) & MASK) {
+        auto& slot = idle.slots[i];
+        if (slot.generation != idle.generation)
+            return nullptr;
+        if (slot.key == key && slot.index != UINT32_MAX)
+            return &slot;
+    }
+}
+
+void Aquamarine::CBackend::insertIdleSlot(std::function<void(void)>* key, uint32_t index) {
+    // keep the load under a half, growing only ever happens while warming up
+    if ((idle.usedSlots + 1) * 2 > idle.slots.size()) {
+        idle.slots.assign(std::max<size_t>(16, idle.slots.size() * 2), SIdleSlot{});
+        idle.usedSlots = 0;
+        for (size_t i = 0; i < idle.pending.size(); ++i) {
+            if (idle.pending[i])
+                insertIdleSlot(idle.pending[i].get(), i);
+        }
+    }
+
+    const size_t MASK = idle.slots.size() - 1;
+    for (size_t i = idleHash(key) & MASK;; i = (i + 1) & MASK) {
+        auto& slot = idle.slots[i];
+        if (slot.generation == idle.generation)
+            continue;
+        slot = SIdleSlot{.key = key, .index = index, .generation = idle.generation};
+        idle.usedSlots++;
+        return;
+    }
+}
+
 void Aquamarine::CBackend::addIdleEvent(SP<std::function<void(void)>> fn) {
-    auto r = idle.pending.emplace_back(fn);
+    if (!fn || findIdleSlot(fn.get()))
+        return;
 
-    updateIdleTimer();
+    insertIdleSlot(fn.get(), idle.pending.size());
+    idle.pending.emplace_back(fn);
+
+    if (!idle.armed)
+        updateIdleTimer();
 }
 
 void Aquamarine::CBackend::updateIdleTimer() {
-    uint64_t ADD_NS = idle.pending.empty() ? TIMESPEC_NSEC_PER_SEC * 240ULL /* 240s, 4 mins */ : 0;
-
     timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
-    timespecAddNs(&now, ADD_NS);
 
     itimerspec ts = {.it_value = now};
 
     if (timerfd_settime(idle.fd, TFD_TIMER_ABSTIME, &ts, nullptr))
         log(AQ_LOG_ERROR, std::format("backend: failed to arm timerfd: {}", strerror(errno)));
+    else
+        idle.armed = true;
 }
 
 void Aquamarine::CBackend::removeIdleEvent(SP<std::function<void(void)>> pfn) {
-    std::erase(idle.pending, pfn);
+    auto slot = findIdleSlot(pfn.get());
+    if (!slot)
+        return;
+
+    // leave a hole, dispatch skips it. The slot stays taken so that probing past it still works
+    idle.pending[slot->index].reset();
+    slot->index = UINT32_MAX;
 }
 
 void Aquamarine::CBackend::dispatchIdle() {
-    auto cpy = idle.pending;
-    idle.pending.clear();
+    uint64_t expirations = 0;
+    if (read(idle.fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        log(AQ_LOG_ERROR, std::format("backend: failed to read idle timerfd: {}", strerror(errno)));
+
+    idle.armed = false;
+
+    // events added while dispatching go into the (now empty) pending queue and run on the next wakeup.
+    // Both vectors keep their capacity, and a new generation frees every slot at once.
+    std::swap(idle.pending, idle.dispatching);
+    idle.usedSlots = 0;
+    if (++idle.generation == 0) {
+        // wrapped around, stale slots could look current again
+        idle.slots.assign(idle.slots.size(), SIdleSlot{});
+        idle.generation = 1;
+    }
 
-    for (auto const& i : cpy) {
+    for (auto const& i : idle.dispatching) {
         if (i && *i)
             (*i)();
     }
 
-    updateIdleTimer();
+    idle.dispatching.clear();
+
+    if (!idle.pending.empty() && !idle.armed)
+        updateIdleTimer();
+}
+
+void Aquamarine::CBackend::postTask(std::function<void(void)> fn) {
+    tasks.push(std::move(fn));
+}
+
+std::shared_ptr<CTaskGate> Aquamarine::CBackend::getTaskGate() {
+    return taskGate;
+}
+
+void Aquamarine::CBackend::addTimer(SP<std::function<void(void)>> fn, uint64_t timeoutMs) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    addTimerAt(fn, (uint64_t)now.tv_sec * TIMESPEC_NSEC_PER_SEC + now.tv_nsec + timeoutMs * 1000000ULL);
+}
+
+void Aquamarine::CBackend::addTimerAt(SP<std::function<void(void)>> fn, uint64_t monotonicNs) {
+    timers.timers.emplace_back(STimer{.fn = fn, .expiresNs = monotonicNs});
+
+    updateTimerFD();
+}
+
+void Aquamarine::CBackend::removeTimer(SP<std::function<void(void)>> pfn) {
+    std::erase_if(timers.timers, [&pfn](const auto& t) { return t.fn == pfn; });
+
+    updateTimerFD();
+}
+
+void Aquamarine::CBackend::updateTimerFD() {
+    uint64_t next = UINT64_MAX;
+    for (auto const& t : timers.timers) {
+        next = std::min(next, t.expiresNs);
+    }
+
+    // a zero it_value disarms, so a timer due at 0 is armed for 1ns, which has long passed too
+    if (timers.timers.empty())
+        next = 0;
+    else
+        next = std::max<uint64_t>(next, 1);
+
+    itimerspec ts = {.it_value = {.tv_sec = (time_t)(next / TIMESPEC_NSEC_PER_SEC), .tv_nsec = (long)(next % TIMESPEC_NSEC_PER_SEC)}};
+
+    if (timerfd_settime(timers.fd, TFD_TIMER_ABSTIME, &ts, nullptr))
+        log(AQ_LOG_ERROR, std::format("backend: failed to arm timers timerfd: {}", strerror(errno)));
+}
+
+void Aquamarine::CBackend::dispatchTimers() {
+    uint64_t expirations = 0;
+    if (read(timers.fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        log(AQ_LOG_ERROR, std::format("backend: failed to read timers timerfd: {}", strerror(errno)));
+
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint64_t NOW = (uint64_t)now.tv_sec * TIMESPEC_NSEC_PER_SEC + now.tv_nsec;
+
+    // timers added while firing go into timers.timers, firing keeps its capacity between dispatches
+    std::erase_if(timers.timers, [&](const auto& t) {
+        if (t.expiresNs > NOW)
+            return false;
+        timers.firing.emplace_back(t);
+        return true;
+    });
+
+    for (auto const& t : timers.firing) {
+        if (t.fn && *t.fn)
+            (*t.fn)();
+    }
+    timers.firing.clear();
+
+    updateTimerFD();
+}
+
+bool Aquamarine::CBackend::initLoop() {
+    if (loop.wakeFD < 0) {
+        log(AQ_LOG_ERROR, "backend: no wakeup eventfd, cannot run the event loop");
+        return false;
+    }
+
+    loop.epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (loop.epollFD < 0) {
+        log(AQ_LOG_ERROR, std::format("backend: epoll_create1 failed: {}", strerror(errno)));
+        return false;
+    }
+
+    epoll_event ev = {.events = EPOLLIN, .data = {.fd = loop.wakeFD}};
+    if (epoll_ctl(loop.epollFD, EPOLL_CTL_ADD, loop.wakeFD, &ev)) {
+        log(AQ_LOG_ERROR, std::format("backend: failed to add the wakeup fd to epoll: {}", strerror(errno)));
+        close(loop.epollFD);
+        loop.epollFD = -1;
+        return false;
+    }
+
+    loop.pollFDsChanged = events.pollFDsChanged.listen([this] { loop.dirty = true; });
+    loop.dirty          = true;
+
+    return true;
+}
+
+void Aquamarine::CBackend::syncLoopFDs() {
+    loop.dirty = false;
+
+    std::unordered_map<int, SP<SPollFD>> next;
+    for (auto const& pfd : getPollFDs()) {
+        if (pfd->fd >= 0)
+            next[pfd->fd] = pfd;
+    }
+
+    for (auto const& [fd, pfd] : loop.fds) {
+        if (!next.contains(fd))
+            epoll_ctl(loop.epollFD, EPOLL_CTL_DEL, fd, nullptr);
+    }
+
+    // fd numbers can be recycled behind our back (epoll drops closed fds on its own), so re-check known fds too
+    for (auto const& [fd, pfd] : next) {
+        epoll_event ev = {.events = EPOLLIN, .data = {.fd = fd}};
+        if (!loop.fds.contains(fd) || epoll_ctl(loop.epollFD, EPOLL_CTL_MOD, fd, &ev)) {
+            if (epoll_ctl(loop.epollFD, EPOLL_CTL_ADD, fd, &ev) && errno != EEXIST)
+                log(AQ_LOG_ERROR, std::format("backend: failed to add fd {} to epoll: {}", fd, strerror(errno)));
+        }
+    }
+
+    loop.fds = std::move(next);
+}
+
+bool Aquamarine::CBackend::dispatchOnce(int timeoutMs) {
+    if (loop.epollFD < 0 && !initLoop())
+        return false;
+
+    if (loop.dirty)
+        syncLoopFDs();
+
+    std::array<epoll_event, 32> epollEvents;
+    const int                   COUNT = epoll_wait(loop.epollFD, epollEvents.data(), epollEvents.size(), timeoutMs);
+    if (COUNT < 0) {
+        if (errno == EINTR)
+            return true;
+        log(AQ_LOG_ERROR, std::format("backend: epoll_wait failed: {}", strerror(errno)));
+        return false;
+    }
+
+    for (int i = 0; i < COUNT; ++i) {
+        const int FD = epollEvents[i].data.fd;
+
+        if (FD == loop.wakeFD) {
+            uint64_t count = 0;
+            if (read(loop.wakeFD, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                log(AQ_LOG_ERROR, std::format("backend: failed to read the wakeup fd: {}", strerror(errno)));
+            continue;
+        }
+
+        // a previous callback may have replaced the fds, in which case this one might be gone already
+        if (loop.dirty)
+            syncLoopFDs();
+
+        const auto IT = loop.fds.find(FD);
+        if (IT == loop.fds.end())
+            continue;
+
+        const auto PFD = IT->second;
+        if (PFD->onSignal)
+            PFD->onSignal();
+    }
+
+    return true;
+}
+
+bool Aquamarine::CBackend::enterLoop() {
+    loop.running = true;
+
+    while (loop.running) {
+        if (!dispatchOnce(-1)) {
+            loop.running = false;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Aquamarine::CBackend::stopLoop() {
+    loop.running = false;
+    wakeLoop();
+}
+
+void Aquamarine::CBackend::wakeLoop() {
+    // can be called from any thread, so no logging here
+    const uint64_t ONE = 1;
+    if (loop.wakeFD >= 0 && write(loop.wakeFD, &ONE, sizeof(ONE)) < 0)
+        return;
 }
 
 void Aquamarine::CBackend::onNewGpu(std::string path) {
@@ -1,4 +1,5 @@
 #include <aquamarine/backend/Headless.hpp>
+#include <aquamarine/output/FrameScheduler.hpp>
 #include <fcntl.h>
 #include <ctime>
 #include <sys/timerfd.h>
@@ -12,6 +13,9 @@ using namespace Hyprutils::Math;
 
 #define TIMESPEC_NSEC_PER_SEC 1000000000LL
 
+// used when the committed state has no mode
+constexpr unsigned int HEADLESS_DEFAULT_REFRESH_MHZ = 60000;
+
 static void timespecAddNs(timespec* pTimespec, int64_t delta) {
     int delta_ns_low = delta % TIMESPEC_NSEC_PER_SEC;
     int delta_s_high = delta / TIMESPEC_NSEC_PER_SEC;
@@ -28,21 +32,37 @@ static void timespecAddNs(timespec* pTimespec, int64_t delta) {
 Aquamarine::CHeadlessOutput::CHeadlessOutput(const std::string& name_, Hyprutils::Memory::CWeakPointer<CHeadlessBackend> backend_) : backend(backend_) {
     name = name_;
 
-    framecb = makeShared<std::function<void()>>([this]() {
-        frameScheduled = false;
-        events.frame.emit();
-    });
+    // there is no vblank, commits stand in for it, so that frames are paced at the mode's refresh rate
+    frameScheduler       = makeShared<CFrameScheduler>(backend->backend, nullptr, [this]() { events.frame.emit(); });
+    frameScheduler->self = frameScheduler;
+    frameScheduler->setTiming(CFrameScheduler::AQ_FRAME_TIMING_OFFSET);
 }
 
 Aquamarine::CHeadlessOutput::~CHeadlessOutput() {
-    backend->backend->removeIdleEvent(framecb);
+    frameScheduler.reset();
     events.destroy.emit();
 }
 
 bool Aquamarine::CHeadlessOutput::commit() {
+    // feeds the swapchain's buffer ages, no damage committed means we don't know what changed
+    const auto& STATE = state->state();
+    if (swapchain && STATE.buffer && (STATE.committed & COutputState::AQ_OUTPUT_STATE_BUFFER)) {
+        const auto& SIZE = swapchain->currentOptions().size;
+        swapchain->presented(STATE.buffer, (STATE.committed & COutputState::AQ_OUTPUT_STATE_DAMAGE) ? STATE.damage : CRegion{0, 0, SIZE.x, SIZE.y});
+    }
+
     events.commit.emit();
     state->onCommit();
     needsFrame = false;
+
+    const auto MODE    = state->state().customMode ? state->state().customMode : state->state().mode.lock();
+    const auto REFRESH = MODE && MODE->refreshRate ? MODE->refreshRate : HEADLESS_DEFAULT_REFRESH_MHZ;
+
+    timespec   now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    frameScheduler->committed();
+    frameScheduler->presented(now, 1000000000000ULL / REFRESH);
+
     events.present.emit(IOutput::SPresentEvent{.presented = true});
     return true;
 }
@@ -61,15 +81,9 @@ Hyprutils::Memory::CSharedPointer<IBackendImplementation> Aquamarine::CHeadlessO
 
 void Aquamarine::CHeadlessOutput::scheduleFrame(const scheduleFrameReason reason) {
     TRACE(backend->backend->log(AQ_LOG_TRACE,
-                                std::format("CHeadlessOutput::scheduleFrame: reason {}, needsFrame {}, frameScheduled {}", (uint32_t)reason, needsFrame, frameScheduled)));
-    // FIXME: limit fps to the committed framerate.
+                                std::format("CHeadlessOutput::scheduleFrame: reason {}, needsFrame {}, frameScheduled {}", (uint32_t)reason, needsFrame, frameScheduler->scheduled())));
     needsFrame = true;
-
-    if (frameScheduled)
-        return;
-
-    frameScheduled = true;
-    backend->backend->addIdleEvent(framecb);
+    frameScheduler->schedule(reason);
 }
 
 bool Aquamarine::CHeadlessOutput::destroy() {
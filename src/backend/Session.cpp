@@ -13,6 +13,17 @@ extern "C" {
 #include <unistd.h>
 }
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <variant>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include "Shared.hpp"
+#include "SPSCRing.hpp"
+
 using namespace Aquamarine;
 using namespace Hyprutils::Memory;
 #define SP CSharedPointer
@@ -54,13 +65,32 @@ static void libseatLog(libseat_log_level level, const char* fmt, va_list args) {
     backendInUse->log(logLevelFromLibseat(level), std::format("[libseat] {}", string));
 }
 
+// set on the input thread (AQ_INPUT_THREAD), see CSession::inputThreadMain
+static thread_local bool onInputThread = false;
+
+// log functions aren't expected to be thread-safe, so the input thread hands its logs to the main thread
+static void logFromInputThread(Aquamarine::eBackendLogLevel level, std::string msg) {
+    if (!backendInUse)
+        return;
+
+    backendInUse->postTask([level, msg = std::move(msg)]() {
+        if (backendInUse)
+            backendInUse->log(level, msg);
+    });
+}
+
 static void libinputLog(libinput*, libinput_log_priority level, const char* fmt, va_list args) {
     if (!backendInUse)
         return;
 
-    static char string[1024];
+    static thread_local char string[1024];
     vsnprintf(string, sizeof(string), fmt, args);
 
+    if (onInputThread) {
+        logFromInputThread(logLevelFromLibinput(level), std::format("[libinput] {}", string));
+        return;
+    }
+
     backendInUse->log(logLevelFromLibinput(level), std::format("[libinput] {}", string));
 }
 
@@ -90,6 +120,7 @@ static const libseat_seat_listener libseatListener = {
 
 //  ------------ Libinput
 
+// with AQ_INPUT_THREAD, these two are called on the input thread, with inputLock held
 static int libinputOpen(const char* path, int flags, void* data) {
     auto SESSION = (CSession*)data;
 
@@ -117,6 +148,320 @@ static const libinput_interface libinputListener = {
     .close_restricted = ::libinputClose,
 };
 
+// ------------ Input thread
+
+// how many events the main thread handles per wakeup before giving other fds a turn
+constexpr size_t INPUT_THREAD_DRAIN_BATCH = 256;
+
+// how many events the input thread holds on to while the ring is full. Past that, it stops reading and leaves them to libinput and the kernel
+constexpr size_t INPUT_THREAD_MAX_BACKLOG = 4096;
+
+namespace Aquamarine {
+    struct SLibinputScrollEvent {
+        std::array<IPointer::SAxisEvent, 2> axes;
+        size_t                              count = 0;
+    };
+
+    struct SLibinputTouchFrameEvent {};
+
+    // a libinput event copied out into plain data, so that it can be handed over without libinput
+    struct SLibinputEvent {
+        libinput_device* device = nullptr;
+
+        // the device's user data when the event was read. Null if its DEVICE_ADDED hasn't been handled on the main thread yet
+        CLibinputDevice* aqDevice = nullptr;
+
+        // events that need the device's state (hotplug, switches, tablets) are handed over as they are,
+        // then handled and destroyed on the main thread with inputLock held
+        libinput_event* raw = nullptr;
+
+        std::variant<std::monostate, IKeyboard::SKeyEvent, IPointer::SMoveEvent, IPointer::SWarpEvent, IPointer::SButtonEvent, SLibinputScrollEvent, IPointer::SSwipeBeginEvent,
+                     IPointer::SSwipeUpdateEvent, IPointer::SSwipeEndEvent, IPointer::SPinchBeginEvent, IPointer::SPinchUpdateEvent, IPointer::SPinchEndEvent,
+                     IPointer::SHoldBeginEvent, IPointer::SHoldEndEvent, ITouch::SDownEvent, ITouch::SUpEvent, ITouch::SMotionEvent, ITouch::SCancelEvent, SLibinputTouchFrameEvent>
+            data;
+    };
+
+    struct SInputThread {
+        ~SInputThread() {
+            if (wakeFD >= 0)
+                close(wakeFD);
+            if (stopFD >= 0)
+                close(stopFD);
+        }
+
+        std::thread                     thread;
+        std::atomic<bool>               stop      = false;
+        std::atomic<bool>               signalled = false;
+        int                             wakeFD    = -1; // input thread -> main thread
+        int                             stopFD    = -1; // main thread -> input thread
+        CSPSCRing<SLibinputEvent, 1024> ring;
+    };
+
+    // the main thread's hold on CSession::inputLock. Signals emitted while holding it can come back for it (e.g. updateLEDs for a new keyboard),
+    // then this doesn't lock again
+    struct SInputLock {
+        SInputLock(CSession* session_) : session(session_) {
+            if (session->inputLockHeld)
+                return;
+
+            session->inputLock.lock();
+            session->inputLockHeld = true;
+            owner                  = true;
+        }
+
+        ~SInputLock() {
+            if (!owner)
+                return;
+
+            session->inputLockHeld = false;
+            session->inputLock.unlock();
+        }
+
+        SInputLock(const SInputLock&)            = delete;
+        SInputLock& operator=(const SInputLock&) = delete;
+
+      private:
+        CSession* session = nullptr;
+        bool      owner   = false;
+    };
+};
+
+enum eLibinputCapture : uint8_t {
+    LIBINPUT_CAPTURE_PLAIN = 0,
+    LIBINPUT_CAPTURE_RAW,
+    LIBINPUT_CAPTURE_DROP,
+};
+
+// merges a relative motion into the one before it, if that's one too, from the same device. Only for the backlog: whatever
+// queues up there while the main thread is busy would be consumed in one go anyway
+static bool coalesceLibinputMotion(SLibinputEvent& into, const SLibinputEvent& event) {
+    auto intoMove  = std::get_if<IPointer::SMoveEvent>(&into.data);
+    auto eventMove = std::get_if<IPointer::SMoveEvent>(&event.data);
+    if (!intoMove || !eventMove || into.raw || event.raw || into.device != event.device)
+        return false;
+
+    intoMove->timeMs  = eventMove->timeMs;
+    intoMove->delta   = intoMove->delta + eventMove->delta;
+    intoMove->unaccel = intoMove->unaccel + eventMove->unaccel;
+    return true;
+}
+
+// copies the high-frequency events out of libinput. This only reads the event (and the device's scroll config), so it's fine on the input thread
+static eLibinputCapture captureLibinputEvent(libinput_event* e, SLibinputEvent& out) {
+    auto device    = libinput_event_get_device(e);
+    auto eventType = libinput_event_get_type(e);
+
+    switch (eventType) {
+            // --------- keyboard
+
+        case LIBINPUT_EVENT_KEYBOARD_KEY: {
+            auto kbe = libinput_event_get_keyboard_event(e);
+            out.data = IKeyboard::SKeyEvent{
+                .timeMs  = (uint32_t)(libinput_event_keyboard_get_time_usec(kbe) / 1000),
+                .key     = libinput_event_keyboard_get_key(kbe),
+                .pressed = libinput_event_keyboard_get_key_state(kbe) == LIBINPUT_KEY_STATE_PRESSED,
+            };
+            break;
+        }
+
+            // --------- pointer
+
+        case LIBINPUT_EVENT_POINTER_MOTION: {
+            auto pe  = libinput_event_get_pointer_event(e);
+            out.data = IPointer::SMoveEvent{
+                .timeMs  = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
+                .delta   = {libinput_event_pointer_get_dx(pe), libinput_event_pointer_get_dy(pe)},
+                .unaccel = {libinput_event_pointer_get_dx_unaccelerated(pe), libinput_event_pointer_get_dy_unaccelerated(pe)},
+            };
+            break;
+        }
+
+        case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE: {
+            auto pe  = libinput_event_get_pointer_event(e);
+            out.data = IPointer::SWarpEvent{
+                .timeMs   = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
+                .absolute = {libinput_event_pointer_get_absolute_x_transformed(pe, 1), libinput_event_pointer_get_absolute_y_transformed(pe, 1)},
+            };
+            break;
+        }
+
+        case LIBINPUT_EVENT_POINTER_BUTTON: {
+            auto       pe        = libinput_event_get_pointer_event(e);
+            const auto SEATCOUNT = libinput_event_pointer_get_seat_button_count(pe);
+            const bool PRESSED   = libinput_event_pointer_get_button_state(pe) == LIBINPUT_BUTTON_STATE_PRESSED;
+
+            if ((PRESSED && SEATCOUNT != 1) || (!PRESSED && SEATCOUNT != 0))
+                return LIBINPUT_CAPTURE_DROP;
+
+            out.data = IPointer::SButtonEvent{
+                .timeMs  = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
+                .button  = libinput_event_pointer_get_button(pe),
+                .pressed = PRESSED,
+            };
+            break;
+        }
+
+        case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
+        case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+        case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: {
+            auto                 pe = libinput_event_get_pointer_event(e);
+
+            IPointer::SAxisEvent aqe = {
+                .timeMs = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
+            };
+
+            switch (eventType) {
+                case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL; break;
+                case LIBINPUT_EVENT_POINTER_SCROLL_FINGER: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_FINGER; break;
+                case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_CONTINUOUS; break;
+                default: break; /* unreachable */
+            }
+
+            static const std::array<libinput_pointer_axis, 2> LAXES = {
+                LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL,
+                LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL,
+            };
+
+            SLibinputScrollEvent scroll;
+
+            for (auto const& axis : LAXES) {
+                if (!libinput_event_pointer_has_axis(pe, axis))
+                    continue;
+
+                aqe.axis      = axis == LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL ? IPointer::AQ_POINTER_AXIS_VERTICAL : IPointer::AQ_POINTER_AXIS_HORIZONTAL;
+                aqe.delta     = libinput_event_pointer_get_scroll_value(pe, axis);
+                aqe.direction = IPointer::AQ_POINTER_AXIS_RELATIVE_IDENTICAL;
+                if (libinput_device_config_scroll_get_natural_scroll_enabled(device))
+                    aqe.direction = IPointer::AQ_POINTER_AXIS_RELATIVE_INVERTED;
+
+                if (aqe.source == IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL)
+                    aqe.discrete = libinput_event_pointer_get_scroll_value_v120(pe, axis);
+
+                scroll.axes[scroll.count++] = aqe;
+            }
+
+            out.data = scroll;
+            break;
+        }
+
+        case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SSwipeBeginEvent{
+                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SSwipeUpdateEvent{
+                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
+                .delta   = {libinput_event_gesture_get_dx(ge), libinput_event_gesture_get_dy(ge)},
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_GESTURE_SWIPE_END: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SSwipeEndEvent{
+                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
+            };
+            break;
+        }
+
+        case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SPinchBeginEvent{
+                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SPinchUpdateEvent{
+                .timeMs   = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .fingers  = (uint32_t)libinput_event_gesture_get_finger_count(ge),
+                .delta    = {libinput_event_gesture_get_dx(ge), libinput_event_gesture_get_dy(ge)},
+                .scale    = libinput_event_gesture_get_scale(ge),
+                .rotation = libinput_event_gesture_get_angle_delta(ge),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_GESTURE_PINCH_END: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SPinchEndEvent{
+                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
+            };
+            break;
+        }
+
+        case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SHoldBeginEvent{
+                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_GESTURE_HOLD_END: {
+            auto ge  = libinput_event_get_gesture_event(e);
+            out.data = IPointer::SHoldEndEvent{
+                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
+                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
+            };
+            break;
+        }
+
+            // --------- touch
+
+        case LIBINPUT_EVENT_TOUCH_DOWN: {
+            auto te  = libinput_event_get_touch_event(e);
+            out.data = ITouch::SDownEvent{
+                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
+                .touchID = libinput_event_touch_get_seat_slot(te),
+                .pos     = {libinput_event_touch_get_x_transformed(te, 1), libinput_event_touch_get_y_transformed(te, 1)},
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_UP: {
+            auto te  = libinput_event_get_touch_event(e);
+            out.data = ITouch::SUpEvent{
+                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
+                .touchID = libinput_event_touch_get_seat_slot(te),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_MOTION: {
+            auto te  = libinput_event_get_touch_event(e);
+            out.data = ITouch::SMotionEvent{
+                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
+                .touchID = libinput_event_touch_get_seat_slot(te),
+                .pos     = {libinput_event_touch_get_x_transformed(te, 1), libinput_event_touch_get_y_transformed(te, 1)},
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_CANCEL: {
+            auto te  = libinput_event_get_touch_event(e);
+            out.data = ITouch::SCancelEvent{
+                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
+                .touchID = libinput_event_touch_get_seat_slot(te),
+            };
+            break;
+        }
+        case LIBINPUT_EVENT_TOUCH_FRAME: {
+            out.data = SLibinputTouchFrameEvent{};
+            break;
+        }
+
+        default: return LIBINPUT_CAPTURE_RAW;
+    }
+
+    return LIBINPUT_CAPTURE_PLAIN;
+}
+
 // ------------
 
 Aquamarine::CSessionDevice::CSessionDevice(Hyprutils::Memory::CSharedPointer<CSession> session_, const std::string& path_) : path(path_), session(session_) {
@@ -315,6 +660,8 @@ SP<CSession> Aquamarine::CSession::attempt(Hyprutils::Memory::CSharedPointer<CBa
 }
 
 Aquamarine::CSession::~CSession() {
+    stopInputThread();
+
     sessionDevices.clear();
     libinputDevices.clear();
 
@@ -346,14 +693,18 @@ static bool isDRMCard(const char* sysname) {
 }
 
 void Aquamarine::CSession::onReady() {
-    ;
+    if (envEnabled("AQ_INPUT_THREAD"))
+        startInputThread();
 }
 
 void Aquamarine::CSession::dispatchUdevEvents() {
     if (!udevHandle || !udevMonitor)
         return;
 
-    auto device = udev_monitor_receive_device(udevMonitor);
+    // new GPUs are opened through libseat and land in sessionDevices, like input devices do on the input thread
+    SInputLock lock(this);
+
+    auto       device = udev_monitor_receive_device(udevMonitor);
 
     if (!device)
         return;
@@ -428,6 +779,12 @@ void Aquamarine::CSession::dispatchLibinputEvents() {
     if (!libinputHandle)
         return;
 
+    // libinput belongs to the input thread, we only take what it has read
+    if (inputThread) {
+        dispatchInputThreadEvents();
+        return;
+    }
+
     if (int ret = libinput_dispatch(libinputHandle); ret) {
         backend->log(AQ_LOG_ERROR, std::format("Couldn't dispatch libinput events: {}", strerror(-ret)));
         return;
@@ -442,6 +799,9 @@ void Aquamarine::CSession::dispatchLibinputEvents() {
 }
 
 void Aquamarine::CSession::dispatchLibseatEvents() {
+    // this can suspend / resume libinput
+    SInputLock lock(this);
+
     if (libseat_dispatch(libseatHandle, 0) == -1)
         backend->log(AQ_LOG_ERROR, "Couldn't dispatch libseat events");
 }
@@ -462,15 +822,21 @@ std::vector<Hyprutils::Memory::CSharedPointer<SPollFD>> Aquamarine::CSession::po
     return {
         makeShared<SPollFD>(libseat_get_fd(libseatHandle), [this](){    dispatchLibseatEvents();  }),
         makeShared<SPollFD>(udev_monitor_get_fd(udevMonitor), [this](){ dispatchUdevEvents();     }),
-        makeShared<SPollFD>(libinput_get_fd(libinputHandle), [this](){  dispatchLibinputEvents(); })
+        makeShared<SPollFD>(inputThread ? inputThread->wakeFD : libinput_get_fd(libinputHandle), [this](){ dispatchLibinputEvents(); })
     };
     // clang-format on
 }
 
 bool Aquamarine::CSession::switchVT(uint32_t vt) {
+    SInputLock lock(this);
     return libseat_switch_session(libseatHandle, vt) == 0;
 }
 
+void Aquamarine::CSession::withLibinput(const std::function<void()>& fn) {
+    SInputLock lock(this);
+    fn();
+}
+
 void Aquamarine::CSession::handleLibinputEvent(libinput_event* e) {
     auto device    = libinput_event_get_device(e);
     auto eventType = libinput_event_get_type(e);
@@ -492,6 +858,13 @@ void Aquamarine::CSession::handleLibinputEvent(libinput_event* e) {
 
     auto hlDevice = ((CLibinputDevice*)data)->self.lock();
 
+    SLibinputEvent plain;
+    switch (captureLibinputEvent(e, plain)) {
+        case LIBINPUT_CAPTURE_PLAIN: emitLibinputEvent(hlDevice, plain); return;
+        case LIBINPUT_CAPTURE_DROP: return;
+        default: break;
+    }
+
     switch (eventType) {
         case LIBINPUT_EVENT_DEVICE_ADDED:
             /* shouldn't happen */
@@ -500,211 +873,6 @@ void Aquamarine::CSession::handleLibinputEvent(libinput_event* e) {
             std::erase_if(libinputDevices, [device](const auto& d) { return d->device == device; });
             break;
 
-            // --------- keyboard
-
-        case LIBINPUT_EVENT_KEYBOARD_KEY: {
-            auto kbe = libinput_event_get_keyboard_event(e);
-            hlDevice->keyboard->events.key.emit(IKeyboard::SKeyEvent{
-                .timeMs  = (uint32_t)(libinput_event_keyboard_get_time_usec(kbe) / 1000),
-                .key     = libinput_event_keyboard_get_key(kbe),
-                .pressed = libinput_event_keyboard_get_key_state(kbe) == LIBINPUT_KEY_STATE_PRESSED,
-            });
-            break;
-        }
-
-            // --------- pointer
-
-        case LIBINPUT_EVENT_POINTER_MOTION: {
-            auto pe = libinput_event_get_pointer_event(e);
-            hlDevice->mouse->events.move.emit(IPointer::SMoveEvent{
-                .timeMs  = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
-                .delta   = {libinput_event_pointer_get_dx(pe), libinput_event_pointer_get_dy(pe)},
-                .unaccel = {libinput_event_pointer_get_dx_unaccelerated(pe), libinput_event_pointer_get_dy_unaccelerated(pe)},
-            });
-            hlDevice->mouse->events.frame.emit();
-            break;
-        }
-
-        case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE: {
-            auto pe = libinput_event_get_pointer_event(e);
-            hlDevice->mouse->events.warp.emit(IPointer::SWarpEvent{
-                .timeMs   = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
-                .absolute = {libinput_event_pointer_get_absolute_x_transformed(pe, 1), libinput_event_pointer_get_absolute_y_transformed(pe, 1)},
-            });
-            hlDevice->mouse->events.frame.emit();
-            break;
-        }
-
-        case LIBINPUT_EVENT_POINTER_BUTTON: {
-            auto       pe        = libinput_event_get_pointer_event(e);
-            const auto SEATCOUNT = libinput_event_pointer_get_seat_button_count(pe);
-            const bool PRESSED   = libinput_event_pointer_get_button_state(pe) == LIBINPUT_BUTTON_STATE_PRESSED;
-
-            if ((PRESSED && SEATCOUNT != 1) || (!PRESSED && SEATCOUNT != 0))
-                break;
-
-            hlDevice->mouse->events.button.emit(IPointer::SButtonEvent{
-                .timeMs  = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
-                .button  = libinput_event_pointer_get_button(pe),
-                .pressed = PRESSED,
-            });
-            hlDevice->mouse->events.frame.emit();
-            break;
-        }
-
-        case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL:
-        case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
-        case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: {
-            auto                 pe = libinput_event_get_pointer_event(e);
-
-            IPointer::SAxisEvent aqe = {
-                .timeMs = (uint32_t)(libinput_event_pointer_get_time_usec(pe) / 1000),
-            };
-
-            switch (eventType) {
-                case LIBINPUT_EVENT_POINTER_SCROLL_WHEEL: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL; break;
-                case LIBINPUT_EVENT_POINTER_SCROLL_FINGER: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_FINGER; break;
-                case LIBINPUT_EVENT_POINTER_SCROLL_CONTINUOUS: aqe.source = IPointer::AQ_POINTER_AXIS_SOURCE_CONTINUOUS; break;
-                default: break; /* unreachable */
-            }
-
-            static const std::array<libinput_pointer_axis, 2> LAXES = {
-                LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL,
-                LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL,
-            };
-
-            for (auto const& axis : LAXES) {
-                if (!libinput_event_pointer_has_axis(pe, axis))
-                    continue;
-
-                aqe.axis      = axis == LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL ? IPointer::AQ_POINTER_AXIS_VERTICAL : IPointer::AQ_POINTER_AXIS_HORIZONTAL;
-                aqe.delta     = libinput_event_pointer_get_scroll_value(pe, axis);
-                aqe.direction = IPointer::AQ_POINTER_AXIS_RELATIVE_IDENTICAL;
-                if (libinput_device_config_scroll_get_natural_scroll_enabled(device))
-                    aqe.direction = IPointer::AQ_POINTER_AXIS_RELATIVE_INVERTED;
-
-                if (aqe.source == IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL)
-                    aqe.discrete = libinput_event_pointer_get_scroll_value_v120(pe, axis);
-
-                hlDevice->mouse->events.axis.emit(aqe);
-            }
-
-            hlDevice->mouse->events.frame.emit();
-            break;
-        }
-
-        case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.swipeBegin.emit(IPointer::SSwipeBeginEvent{
-                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.swipeUpdate.emit(IPointer::SSwipeUpdateEvent{
-                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
-                .delta   = {libinput_event_gesture_get_dx(ge), libinput_event_gesture_get_dy(ge)},
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_GESTURE_SWIPE_END: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.swipeEnd.emit(IPointer::SSwipeEndEvent{
-                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
-            });
-            break;
-        }
-
-        case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.pinchBegin.emit(IPointer::SPinchBeginEvent{
-                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.pinchUpdate.emit(IPointer::SPinchUpdateEvent{
-                .timeMs   = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .fingers  = (uint32_t)libinput_event_gesture_get_finger_count(ge),
-                .delta    = {libinput_event_gesture_get_dx(ge), libinput_event_gesture_get_dy(ge)},
-                .scale    = libinput_event_gesture_get_scale(ge),
-                .rotation = libinput_event_gesture_get_angle_delta(ge),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_GESTURE_PINCH_END: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.pinchEnd.emit(IPointer::SPinchEndEvent{
-                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
-            });
-            break;
-        }
-
-        case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.holdBegin.emit(IPointer::SHoldBeginEvent{
-                .timeMs  = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .fingers = (uint32_t)libinput_event_gesture_get_finger_count(ge),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_GESTURE_HOLD_END: {
-            auto ge = libinput_event_get_gesture_event(e);
-            hlDevice->mouse->events.holdEnd.emit(IPointer::SHoldEndEvent{
-                .timeMs    = (uint32_t)(libinput_event_gesture_get_time_usec(ge) / 1000),
-                .cancelled = (bool)libinput_event_gesture_get_cancelled(ge),
-            });
-            break;
-        }
-
-            // --------- touch
-
-        case LIBINPUT_EVENT_TOUCH_DOWN: {
-            auto te = libinput_event_get_touch_event(e);
-            hlDevice->touch->events.down.emit(ITouch::SDownEvent{
-                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
-                .touchID = libinput_event_touch_get_seat_slot(te),
-                .pos     = {libinput_event_touch_get_x_transformed(te, 1), libinput_event_touch_get_y_transformed(te, 1)},
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_TOUCH_UP: {
-            auto te = libinput_event_get_touch_event(e);
-            hlDevice->touch->events.up.emit(ITouch::SUpEvent{
-                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
-                .touchID = libinput_event_touch_get_seat_slot(te),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_TOUCH_MOTION: {
-            auto te = libinput_event_get_touch_event(e);
-            hlDevice->touch->events.move.emit(ITouch::SMotionEvent{
-                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
-                .touchID = libinput_event_touch_get_seat_slot(te),
-                .pos     = {libinput_event_touch_get_x_transformed(te, 1), libinput_event_touch_get_y_transformed(te, 1)},
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_TOUCH_CANCEL: {
-            auto te = libinput_event_get_touch_event(e);
-            hlDevice->touch->events.cancel.emit(ITouch::SCancelEvent{
-                .timeMs  = (uint32_t)(libinput_event_touch_get_time_usec(te) / 1000),
-                .touchID = libinput_event_touch_get_seat_slot(te),
-            });
-            break;
-        }
-        case LIBINPUT_EVENT_TOUCH_FRAME: {
-            hlDevice->touch->events.frame.emit();
-            break;
-        }
-
             // --------- switch
 
         case LIBINPUT_EVENT_SWITCH_TOGGLE: {
@@ -826,6 +994,223 @@ void Aquamarine::CSession::handleLibinputEvent(libinput_event* e) {
     }
 }
 
+void Aquamarine::CSession::emitLibinputEvent(SP<CLibinputDevice> dev, const SLibinputEvent& event) {
+    std::visit(
+        [dev](const auto& e) {
+            using T = std::decay_t<decltype(e)>;
+
+            if constexpr (std::is_same_v<T, IKeyboard::SKeyEvent>)
+                dev->keyboard->events.key.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SMoveEvent>) {
+                dev->mouse->events.move.emit(e);
+                dev->mouse->events.frame.emit();
+            } else if constexpr (std::is_same_v<T, IPointer::SWarpEvent>) {
+                dev->mouse->events.warp.emit(e);
+                dev->mouse->events.frame.emit();
+            } else if constexpr (std::is_same_v<T, IPointer::SButtonEvent>) {
+                dev->mouse->events.button.emit(e);
+                dev->mouse->events.frame.emit();
+            } else if constexpr (std::is_same_v<T, SLibinputScrollEvent>) {
+                for (size_t i = 0; i < e.count; ++i) {
+                    dev->mouse->events.axis.emit(e.axes[i]);
+                }
+                dev->mouse->events.frame.emit();
+            } else if constexpr (std::is_same_v<T, IPointer::SSwipeBeginEvent>)
+                dev->mouse->events.swipeBegin.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SSwipeUpdateEvent>)
+                dev->mouse->events.swipeUpdate.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SSwipeEndEvent>)
+                dev->mouse->events.swipeEnd.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SPinchBeginEvent>)
+                dev->mouse->events.pinchBegin.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SPinchUpdateEvent>)
+                dev->mouse->events.pinchUpdate.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SPinchEndEvent>)
+                dev->mouse->events.pinchEnd.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SHoldBeginEvent>)
+                dev->mouse->events.holdBegin.emit(e);
+            else if constexpr (std::is_same_v<T, IPointer::SHoldEndEvent>)
+                dev->mouse->events.holdEnd.emit(e);
+            else if constexpr (std::is_same_v<T, ITouch::SDownEvent>)
+                dev->touch->events.down.emit(e);
+            else if constexpr (std::is_same_v<T, ITouch::SUpEvent>)
+                dev->touch->events.up.emit(e);
+            else if constexpr (std::is_same_v<T, ITouch::SMotionEvent>)
+                dev->touch->events.move.emit(e);
+            else if constexpr (std::is_same_v<T, ITouch::SCancelEvent>)
+                dev->touch->events.cancel.emit(e);
+            else if constexpr (std::is_same_v<T, SLibinputTouchFrameEvent>)
+                dev->touch->events.frame.emit();
+        },
+        event.data);
+}
+
+void Aquamarine::CSession::startInputThread() {
+    if (inputThread || !libinputHandle)
+        return;
+
+    auto thread    = std::make_unique<SInputThread>();
+    thread->wakeFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    thread->stopFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (thread->wakeFD < 0 || thread->stopFD < 0) {
+        backend->log(AQ_LOG_ERROR, "libinput: couldn't create eventfds for the input thread, reading input on the main thread");
+        return;
+    }
+
+    inputThread         = std::move(thread);
+    inputThread->thread = std::thread([this]() { inputThreadMain(); });
+
+    backend->log(AQ_LOG_DEBUG, "libinput: reading input on a dedicated thread");
+}
+
+void Aquamarine::CSession::stopInputThread() {
+    if (!inputThread)
+        return;
+
+    const uint64_t ONE = 1;
+    inputThread->stop.store(true);
+    if (write(inputThread->stopFD, &ONE, sizeof(ONE)) < 0 && backend)
+        backend->log(AQ_LOG_ERROR, "libinput: couldn't wake the input thread to stop it");
+
+    if (inputThread->thread.joinable())
+        inputThread->thread.join();
+
+    // raw events still hold on to libinput
+    SLibinputEvent event;
+    while (inputThread->ring.pop(event)) {
+        if (event.raw)
+            libinput_event_destroy(event.raw);
+    }
+
+    inputThread.reset();
+}
+
+void Aquamarine::CSession::inputThreadMain() {
+    onInputThread = true;
+
+    // events that didn't fit in the ring wait here for the main thread to catch up, input keeps being read meanwhile
+    std::deque<SLibinputEvent> backlog;
+    bool                       unread = false; // libinput has events queued that we stopped reading at a full backlog
+
+    std::array<pollfd, 2>      fds = {
+        pollfd{.fd = libinput_get_fd(libinputHandle), .events = POLLIN, .revents = 0},
+        pollfd{.fd = inputThread->stopFD, .events = POLLIN, .revents = 0},
+    };
+
+    while (!inputThread->stop.load()) {
+        // with a full backlog, leave the fd alone until there's room again
+        fds[0].events = backlog.size() < INPUT_THREAD_MAX_BACKLOG ? POLLIN : 0;
+
+        // with a backlog, come back soon even if nothing new arrives
+        if (poll(fds.data(), fds.size(), backlog.empty() ? -1 : 1) < 0 && errno != EINTR) {
+            logFromInputThread(AQ_LOG_ERROR, std::format("libinput: input thread poll failed: {}", strerror(errno)));
+            break;
+        }
+
+        if (inputThread->stop.load())
+            break;
+
+        bool pushed = false;
+
+        if ((fds[0].revents & POLLIN) || (unread && backlog.size() < INPUT_THREAD_MAX_BACKLOG)) {
+            std::lock_guard<std::mutex> lg(inputLock);
+
+            if (fds[0].revents & POLLIN) {
+                if (int ret = libinput_dispatch(libinputHandle); ret)
+                    logFromInputThread(AQ_LOG_ERROR, std::format("Couldn't dispatch libinput events: {}", strerror(-ret)));
+            }
+
+            unread = false;
+            while (true) {
+                if (backlog.size() >= INPUT_THREAD_MAX_BACKLOG) {
+                    unread = true;
+                    break;
+                }
+
+                auto e = libinput_get_event(libinputHandle);
+                if (!e)
+                    break;
+
+                SLibinputEvent event;
+                event.device   = libinput_event_get_device(e);
+                event.aqDevice = (CLibinputDevice*)libinput_device_get_user_data(event.device);
+
+                const auto CAPTURE = captureLibinputEvent(e, event);
+                if (CAPTURE == LIBINPUT_CAPTURE_RAW)
+                    event.raw = e;
+                else
+                    libinput_event_destroy(e);
+
+                if (CAPTURE == LIBINPUT_CAPTURE_DROP)
+                    continue;
+
+                // keep the order: nothing skips the backlog
+                if (backlog.empty() && inputThread->ring.push(event))
+                    pushed = true;
+                else if (backlog.empty() || !coalesceLibinputMotion(backlog.back(), event))
+                    backlog.emplace_back(event);
+            }
+        }
+
+        while (!backlog.empty() && inputThread->ring.push(backlog.front())) {
+            backlog.pop_front();
+            pushed = true;
+        }
+
+        // one wakeup per drain is enough, it's reset right before the main thread starts popping
+        const uint64_t ONE = 1;
+        if (pushed && !inputThread->signalled.exchange(true) && write(inputThread->wakeFD, &ONE, sizeof(ONE)) < 0)
+            logFromInputThread(AQ_LOG_ERROR, "libinput: couldn't wake the main thread");
+    }
+
+    std::lock_guard<std::mutex> lg(inputLock);
+    for (auto const& event : backlog) {
+        if (event.raw)
+            libinput_event_destroy(event.raw);
+    }
+}
+
+void Aquamarine::CSession::dispatchInputThreadEvents() {
+    if (!inputThread)
+        return;
+
+    uint64_t count = 0;
+    if (read(inputThread->wakeFD, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return;
+
+    inputThread->signalled.store(false);
+
+    size_t         handled = 0;
+    SLibinputEvent event;
+    while (handled < INPUT_THREAD_DRAIN_BATCH && inputThread->ring.pop(event)) {
+        ++handled;
+
+        if (event.raw) {
+            SInputLock lock(this);
+            handleLibinputEvent(event.raw);
+            libinput_event_destroy(event.raw);
+            continue;
+        }
+
+        // the device is still alive: its removal comes through the ring too, after this. If it was read before its DEVICE_ADDED was handled,
+        // the device has been added by now, as that came first
+        CLibinputDevice* dev = event.aqDevice;
+        if (!dev) {
+            auto it = std::ranges::find_if(libinputDevices, [&event](const auto& d) { return d->device == event.device; });
+            if (it == libinputDevices.end())
+                continue;
+            dev = it->get();
+        }
+
+        emitLibinputEvent(dev->self.lock(), event);
+    }
+
+    // leave the rest for the next wakeup so that other fds get a turn
+    const uint64_t ONE = 1;
+    if (handled == INPUT_THREAD_DRAIN_BATCH && !inputThread->signalled.exchange(true) && write(inputThread->wakeFD, &ONE, sizeof(ONE)) < 0)
+        backend->log(AQ_LOG_ERROR, "libinput: couldn't re-arm the input thread wakeup");
+}
+
 void Aquamarine::CSession::handleLibinputTabletToolAxis(libinput_event* e) {
     auto                device   = libinput_event_get_device(e);
     auto                data     = libinput_device_get_user_data(device);
@@ -983,7 +1368,13 @@ const std::string& Aquamarine::CLibinputKeyboard::getName() {
 }
 
 void Aquamarine::CLibinputKeyboard::updateLEDs(uint32_t leds) {
-    libinput_device_led_update(device->device, (libinput_led)leds);
+    auto session = device->session.lock();
+    if (!session) {
+        libinput_device_led_update(device->device, (libinput_led)leds);
+        return;
+    }
+
+    session->withLibinput([this, leds]() { libinput_device_led_update(device->device, (libinput_led)leds); });
 }
 
 Aquamarine::CLibinputMouse::CLibinputMouse(Hyprutils::Memory::CSharedPointer<CLibinputDevice> dev) : device(dev) {
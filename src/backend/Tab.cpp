@@ -5,12 +5,18 @@
 #include "aquamarine/buffer/Buffer.hpp"
 #include "aquamarine/input/Input.hpp"
 #include "aquamarine/output/Output.hpp"
+#include "aquamarine/output/FrameScheduler.hpp"
+#include "Shared.hpp"
 #include <algorithm>
 #include <cstdio>
 #include <drm_fourcc.h>
 #include <format>
 #include <optional>
 #include <ctime>
+#include <cstring>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
 #include <unistd.h>
 
 using namespace Aquamarine;
@@ -18,8 +24,43 @@ using namespace Hyprutils::Memory;
 using namespace Hyprutils::Math;
 #define SP CSharedPointer
 
+#define TIMESPEC_NSEC_PER_SEC 1000000000LL
+
 namespace {
 
+timespec nsToTimespec(uint64_t ns) {
+    return timespec{.tv_sec = (time_t)(ns / TIMESPEC_NSEC_PER_SEC), .tv_nsec = (long)(ns % TIMESPEC_NSEC_PER_SEC)};
+}
+
+// headroom on top of the render time and Shift's composition latency estimates, covers wakeup jitter
+constexpr uint64_t TAB_DEADLINE_SLACK_NS = 1000000;
+
+// reconnection attempts back off exponentially between these
+constexpr uint64_t TAB_RECONNECT_MIN_MS = 50;
+constexpr uint64_t TAB_RECONNECT_MAX_MS = 2000;
+
+template <typename T>
+IPointer::SAxisEvent axisEventFromTab(const T& axis) {
+    IPointer::SAxisEvent ev;
+    ev.timeMs = (uint32_t)(axis.time_usec / 1000);
+    ev.axis   = axis.orientation == TAB_AXIS_VERTICAL ? IPointer::AQ_POINTER_AXIS_VERTICAL : IPointer::AQ_POINTER_AXIS_HORIZONTAL;
+    switch (axis.source) {
+        case TAB_AXIS_SOURCE_WHEEL: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL; break;
+        case TAB_AXIS_SOURCE_FINGER: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_FINGER; break;
+        case TAB_AXIS_SOURCE_CONTINUOUS: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_CONTINUOUS; break;
+        case TAB_AXIS_SOURCE_WHEEL_TILT: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_TILT; break;
+    }
+    ev.delta    = axis.delta;
+    ev.discrete = axis.delta_discrete;
+    return ev;
+}
+
+// which way a scroll event goes along its axis, 0 for the zero-delta event that ends a scroll sequence
+int axisDirection(const IPointer::SAxisEvent& ev) {
+    const double VALUE = ev.delta != 0 ? ev.delta : ev.discrete;
+    return (VALUE > 0) - (VALUE < 0);
+}
+
 class CTabKeyboard : public IKeyboard {
   public:
     const std::string& getName() override {
@@ -111,7 +152,7 @@ class CTabTabletTool : public ITabletTool {
 class CTabBuffer : public IBuffer {
   public:
     explicit CTabBuffer(const TabFrameTarget& target_) : target(target_) {
-        ;
+        size = {double(target.width), double(target.height)};
     }
 
     ~CTabBuffer() override {
@@ -136,15 +177,16 @@ class CTabBuffer : public IBuffer {
     }
 
     SDMABUFAttrs dmabuf() override {
+        // Shift hands out single-plane buffers without a modifier, the layout is implied by the format
         SDMABUFAttrs attrs;
-        attrs.success          = target.dmabuf.fd >= 0;
-        attrs.size             = {double(target.width), double(target.height)};
-        attrs.format           = target.dmabuf.fourcc;
-        attrs.modifier         = DRM_FORMAT_MOD_INVALID;
-        attrs.strides[0]       = target.dmabuf.stride;
-        attrs.offsets[0]       = target.dmabuf.offset;
-        attrs.fds[0]           = target.dmabuf.fd;
-        attrs.planes           = 1;
+        attrs.success    = target.dmabuf.fd >= 0 && target.dmabuf.stride > 0;
+        attrs.size       = {double(target.width), double(target.height)};
+        attrs.format     = target.dmabuf.fourcc;
+        attrs.modifier   = DRM_FORMAT_MOD_INVALID;
+        attrs.planes     = 1;
+        attrs.strides[0] = target.dmabuf.stride;
+        attrs.offsets[0] = target.dmabuf.offset;
+        attrs.fds[0]     = target.dmabuf.fd;
         return attrs;
     }
 
@@ -152,21 +194,50 @@ class CTabBuffer : public IBuffer {
         return false;
     }
 
+    // whether a freshly acquired target describes the same memory layout as ours
+    bool sameLayout(const TabFrameTarget& other) const {
+        return other.width == target.width && other.height == target.height && other.dmabuf.fourcc == target.dmabuf.fourcc && other.dmabuf.stride == target.dmabuf.stride &&
+            other.dmabuf.offset == target.dmabuf.offset;
+    }
+
   private:
     TabFrameTarget target;
 };
 
+// Shift recycles a small, fixed set of dmabufs per monitor and hands us a fresh fd for one of them
+// on every acquire. A dmabuf has a unique inode for its whole lifetime, so we key our wrappers on that
+// and keep handing out the same IBuffer, which keeps consumer attachments (EGLImages, FBs...) alive.
+struct STabSlot {
+    dev_t                      dev           = 0;
+    ino_t                      inode         = 0;
+    uint64_t                   lastAcquired  = 0;
+    uint64_t                   lastPresented = 0; // 0 means never, contents are undefined
+    CSharedPointer<CTabBuffer> buffer;
+};
+
+constexpr size_t TAB_MAX_CACHED_SLOTS = 8;
+
 class CTabSwapchain : public ISwapchain {
   public:
-    CTabSwapchain(const TabMonitorInfo& monitor_info, TabClientHandle* handle)
-        : client(handle), monitorID(monitor_info.id) {
-        options.length = 2;
+    CTabSwapchain(const TabMonitorInfo& monitor_info, TabClientHandle* handle, bool mailbox_)
+        : client(handle), monitorID(monitor_info.id), mailbox(mailbox_) {
+        // mailbox needs a third buffer to render into while one is held back and one is on Shift
+        options.length = mailbox ? 3 : 2;
         options.size   = {monitor_info.width, monitor_info.height};
         options.format = DRM_FORMAT_ARGB8888;
     }
 
     bool reconfigure(const SSwapchainOptions& options_) override {
-        options = options_;
+        if (options_.size != options.size || (options_.format != DRM_FORMAT_INVALID && options_.format != options.format)) {
+            slots.clear();
+            damageRing.clear();
+        }
+
+        const auto OLD_LENGTH = options.length;
+        options               = options_;
+        if (options.length == 0)
+            options.length = OLD_LENGTH;
+
         return true;
     }
 
@@ -181,29 +252,101 @@ class CTabSwapchain : public ISwapchain {
         if (res != TAB_ACQUIRE_OK)
             return nullptr;
 
+        ++acquires;
+
         pending = target.dmabuf.fd >= 0;
-        return CSharedPointer<IBuffer>(new CTabBuffer(target));
+        if (!pending)
+            return CSharedPointer<IBuffer>(new CTabBuffer(target));
+
+        auto buffer = bufferForTarget(target);
+        lastBuffer  = buffer;
+
+        if (age) {
+            auto slot = slotFor(buffer);
+            *age      = slot && slot->lastPresented ? (int)(presentSeq - slot->lastPresented + 1) : 0;
+        }
+
+        return buffer;
     }
 
     const SSwapchainOptions& currentOptions() override {
         return options;
     }
 
+    CRegion damageForAge(int age) override {
+        return damageRing.accumulate(age, options.size);
+    }
+
+    // the last acquired buffer was sent to Shift with the given damage
+    void onPresented(const CRegion& damage) {
+        ++presentSeq;
+        damageRing.push(damage);
+        if (auto slot = slotFor(lastBuffer.lock()))
+            slot->lastPresented = presentSeq;
+    }
+
     void rollback() override {
         pending = false;
     }
 
+    // the connection to Shift was replaced (or lost, with a null handle), buffers from the old one are gone
+    void rebind(TabClientHandle* handle) {
+        client     = handle;
+        pending    = false;
+        lastBuffer = {};
+        slots.clear();
+        damageRing.clear();
+    }
+
     bool takePending() {
         bool had = pending;
         pending  = false;
         return had;
     }
 
+    // how many swaps may be in flight before we have to wait for a FRAME_DONE. In mailbox mode, one more frame can be held back on our side
+    size_t maxFramesInFlight() const {
+        return mailbox ? 1 : std::max<size_t>(1, options.length - 1);
+    }
+
   private:
-    TabClientHandle*  client = nullptr;
-    std::string       monitorID;
-    SSwapchainOptions options;
-    bool              pending = false;
+    TabClientHandle*      client = nullptr;
+    std::string           monitorID;
+    SSwapchainOptions     options;
+    bool                  pending = false, mailbox = false;
+    std::vector<STabSlot> slots;
+    uint64_t              acquireSeq = 0, presentSeq = 0, acquires = 0;
+    CWeakPointer<IBuffer> lastBuffer;
+    CSwapchainDamageRing  damageRing;
+
+    STabSlot* slotFor(const CSharedPointer<IBuffer>& buffer) {
+        auto it = std::ranges::find_if(slots, [&buffer](const auto& s) { return s.buffer == buffer; });
+        return it == slots.end() ? nullptr : &*it;
+    }
+
+    CSharedPointer<IBuffer> bufferForTarget(const TabFrameTarget& target) {
+        struct stat st {};
+        if (fstat(target.dmabuf.fd, &st) != 0)
+            return CSharedPointer<IBuffer>(new CTabBuffer(target));
+
+        ++acquireSeq;
+
+        auto it = std::ranges::find_if(slots, [&st](const auto& s) { return s.dev == st.st_dev && s.inode == st.st_ino; });
+        if (it != slots.end() && it->buffer->sameLayout(target)) {
+            // we already hold an fd for this dmabuf, the new one is redundant
+            close(target.dmabuf.fd);
+            it->lastAcquired = acquireSeq;
+            return it->buffer;
+        }
+
+        if (it != slots.end())
+            slots.erase(it);
+        else if (slots.size() >= TAB_MAX_CACHED_SLOTS)
+            slots.erase(std::ranges::min_element(slots, {}, &STabSlot::lastAcquired));
+
+        auto& slot = slots.emplace_back(STabSlot{.dev = st.st_dev, .inode = st.st_ino, .lastAcquired = acquireSeq, .buffer = makeShared<CTabBuffer>(target)});
+        return slot.buffer;
+    }
 
     friend class CTabOutput;
 };
@@ -223,15 +366,28 @@ CTabOutput::CTabOutput(const TabMonitorInfo& monitor_info, CWeakPointer<CTabBack
     modes.emplace_back(mode);
     state->setMode(mode);
 
-    swapchain = CSharedPointer<ISwapchain>(new CTabSwapchain(monitor_info, backend.lock()->ensureClient()));
+    auto be   = backend.lock();
+    swapchain = CSharedPointer<ISwapchain>(new CTabSwapchain(monitor_info, be->ensureClient(), be->mailbox));
+
+    // tab_client can't turn adaptive sync on, nor tell whether the monitor could do it
+    vrrCapable = false;
 }
 
 CTabOutput::~CTabOutput() {
+    frameScheduler.reset();
     events.destroy.emit();
 }
 
 bool CTabOutput::commit() {
     events.commit.emit();
+
+    // no damage committed means we don't know what changed
+    const auto& STATE  = state->state();
+    const auto  DAMAGE = (STATE.committed & COutputState::AQ_OUTPUT_STATE_DAMAGE) ? STATE.damage : CRegion{0, 0, swapchain->currentOptions().size.x, swapchain->currentOptions().size.y};
+
+    if (!test())
+        return false;
+
     state->onCommit();
     needsFrame = false;
     auto be = backend.lock();
@@ -242,18 +398,74 @@ bool CTabOutput::commit() {
     if (!sc)
         return true;
 
-    if (auto client = be->ensureClient()) {
-        const bool sent = sc->takePending();
-        if (sent)
-            tab_client_swap_buffers(client, monitorID.c_str());
-        if (sent)
-            awaitingFrameDone = true;
+    if (auto client = be->ensureClient(); client && sc->takePending()) {
+        if (sc->mailbox && framesInFlight >= sc->maxFramesInFlight()) {
+            // Shift still has our last frame, hold this one back until it's done. A newer frame replaces it
+            if (queued.pending)
+                events.present.emit(IOutput::SPresentEvent{.presented = false});
+            queued.pending = true;
+            queued.acquire = sc->acquires;
+            queued.damage.add(DAMAGE);
+        } else
+            swapBuffers(client, DAMAGE);
+        frameScheduler->committed();
     }
 
     return true;
 }
 
+void CTabOutput::swapBuffers(TabClientHandle* client, const CRegion& damage) {
+    auto sc = dynamicPointerCast<CTabSwapchain>(swapchain);
+    tab_client_swap_buffers(client, monitorID.c_str());
+    sc->onPresented(damage);
+    awaitingFrameDone = true;
+    ++framesInFlight;
+}
+
+void CTabOutput::swapQueued(TabClientHandle* client) {
+    if (!queued.pending)
+        return;
+
+    auto sc        = dynamicPointerCast<CTabSwapchain>(swapchain);
+    queued.pending = false;
+
+    // Shift swaps the last frame we acquired. If that's not the held back one anymore, it's lost
+    if (sc->acquires != queued.acquire) {
+        queued.damage.clear();
+        events.present.emit(IOutput::SPresentEvent{.presented = false});
+        scheduleFrame(AQ_SCHEDULE_NEEDS_FRAME);
+        return;
+    }
+
+    swapBuffers(client, queued.damage);
+    queued.damage.clear();
+}
+
+bool CTabOutput::canStartFrame() {
+    // in mailbox mode a frame can always start, it replaces the held back one if Shift is still busy
+    auto sc = dynamicPointerCast<CTabSwapchain>(swapchain);
+    return (sc && sc->mailbox) || framesInFlight < (sc ? sc->maxFramesInFlight() : 1);
+}
+
 bool CTabOutput::test() {
+    const auto& STATE = state->state();
+
+    // compositors probe these with test() every frame, that's not worth more than a trace log
+    if (STATE.adaptiveSync && !vrrCapable) {
+        if (auto be = backend.lock(); be && be->backend.lock())
+            TRACE(be->backend.lock()->log(AQ_LOG_TRACE, std::format("tab: No adaptive sync support for output {}", name)));
+        return false;
+    }
+
+    if (STATE.presentationMode == AQ_OUTPUT_PRESENTATION_IMMEDIATE) {
+        if (auto be = backend.lock(); be && be->backend.lock())
+            TRACE(be->backend.lock()->log(AQ_LOG_TRACE, "tab: No immediate presentation support in Shift"));
+        return false;
+    }
+
+    if ((STATE.committed & COutputState::AQ_OUTPUT_STATE_BUFFER) && !STATE.buffer)
+        return false;
+
     return true;
 }
 
@@ -261,26 +473,63 @@ SP<IBackendImplementation> CTabOutput::getBackend() {
     return backend.lock();
 }
 
-void CTabOutput::scheduleFrame(const scheduleFrameReason) {
+void CTabOutput::scheduleFrame(const scheduleFrameReason reason) {
     needsFrame = true;
-    if (awaitingFrameDone || frameEventScheduled)
-        return;
-    frameEventScheduled = true;
+    frameScheduler->schedule(reason);
+}
 
-    auto be = backend.lock();
-    if (!be)
-        return;
-    if (auto core = be->backend.lock()) {
-        if (!frameIdle)
-            return;
-        core->addIdleEvent(frameIdle);
+void CTabOutput::onConnectionLost() {
+    // whatever was queued on the old Shift, or held back for it, will never be shown
+    if (awaitingFrameDone)
+        events.present.emit(IOutput::SPresentEvent{.presented = false});
+    if (queued.pending)
+        events.present.emit(IOutput::SPresentEvent{.presented = false});
+
+    awaitingFrameDone = false;
+    framesInFlight    = 0;
+    queued.pending    = false;
+    queued.damage.clear();
+    frameScheduler->cancel();
+
+    if (auto sc = dynamicPointerCast<CTabSwapchain>(swapchain))
+        sc->rebind(nullptr);
+}
+
+void CTabOutput::reconcile(const TabMonitorInfo& monitor_info, TabClientHandle* client) {
+    refreshRateHz     = monitor_info.refresh_rate > 0 ? monitor_info.refresh_rate : 60;
+    refreshIntervalNs = (int)(1000000000LL / refreshRateHz);
+    lastPresentTime   = {};
+    frameScheduler->presented({}, 0);
+
+    const Vector2D SIZE    = {double(monitor_info.width), double(monitor_info.height)};
+    const bool     RESIZED = physicalSize != SIZE;
+    physicalSize           = SIZE;
+
+    if (auto sc = dynamicPointerCast<CTabSwapchain>(swapchain)) {
+        sc->rebind(client);
+        if (RESIZED)
+            sc->reconfigure(SSwapchainOptions{.length = sc->currentOptions().length, .size = SIZE, .format = sc->currentOptions().format});
+    }
+
+    if (RESIZED) {
+        const unsigned refreshmHz = refreshRateHz * 1000U;
+        auto           mode       = CSharedPointer<SOutputMode>(new SOutputMode({.pixelSize = SIZE, .refreshRate = refreshmHz, .preferred = true}));
+        modes                     = {mode};
+        state->setMode(mode);
+        events.state.emit(IOutput::SStateEvent{.size = SIZE});
     }
+
+    // the new Shift has nothing on screen for us yet
+    scheduleFrame(AQ_SCHEDULE_NEW_MONITOR);
 }
 
 bool CTabOutput::destroy() {
     events.destroy.emit();
-    if (auto be = backend.lock())
+    if (auto be = backend.lock()) {
+        if (handle < be->outputsByHandle.size() && be->outputsByHandle[handle].get() == this)
+            be->outputsByHandle[handle].reset();
         std::erase_if(be->outputs, [this](const auto& other) { return other.get() == this; });
+    }
     return true;
 }
 
@@ -291,10 +540,15 @@ std::vector<SDRMFormat> CTabOutput::getRenderFormats() {
 }
 
 CTabBackend::CTabBackend(CSharedPointer<CBackend> backend_) : backend(backend_) {
-    ;
+    coalesce.enabled = envEnabled("AQ_TAB_COALESCE_INPUT");
+    renderDeadline   = envEnabled("AQ_TAB_RENDER_DEADLINE");
+    mailbox          = envEnabled("AQ_TAB_MAILBOX");
 }
 
 CTabBackend::~CTabBackend() {
+    if (reconnect.timerfd >= 0)
+        close(reconnect.timerfd);
+
     if (client) {
         tab_client_disconnect(client);
         client = nullptr;
@@ -302,7 +556,8 @@ CTabBackend::~CTabBackend() {
 }
 
 TabClientHandle* CTabBackend::ensureClient() {
-    if (client)
+    // while reconnecting, connection attempts are paced by the backoff timer
+    if (client || reconnect.backoffMs)
         return client;
     const char* token = std::getenv("SHIFT_SESSION_TOKEN");
     client            = tab_client_connect_default(token);
@@ -311,11 +566,22 @@ TabClientHandle* CTabBackend::ensureClient() {
     return client;
 }
 
-CTabOutput* CTabBackend::findOutputByID(const std::string& id) {
-    for (auto& output : outputs)
-        if (output->monitorID == id)
-            return output.get();
-    return nullptr;
+uint32_t CTabBackend::internMonitorID(std::string_view id) {
+    if (const auto it = monitorHandles.find(id); it != monitorHandles.end())
+        return it->second;
+
+    // handles are never reused, a monitor that comes back gets its old one
+    const uint32_t HANDLE = (uint32_t)outputsByHandle.size();
+    monitorHandles.emplace(std::string{id}, HANDLE);
+    outputsByHandle.emplace_back();
+    return HANDLE;
+}
+
+CTabOutput* CTabBackend::findOutputByID(std::string_view id) {
+    const auto it = monitorHandles.find(id);
+    if (it == monitorHandles.end())
+        return nullptr;
+    return outputsByHandle[it->second].get();
 }
 
 eBackendType CTabBackend::type() {
@@ -330,29 +596,117 @@ bool CTabBackend::start() {
     if (core)
         core->log(AQ_LOG_DEBUG, "tab backend: connected to Shift");
 
+    syncMonitors();
+
+    if (core)
+        core->events.pollFDsChanged.emit();
+
+    return true;
+}
+
+void CTabBackend::syncMonitors() {
+    // outputs Shift still knows about are kept, so that the compositor doesn't see them flicker away on a reconnect
+    auto stale = outputs;
+
     const size_t count = tab_client_get_monitor_count(client);
     for (size_t i = 0; i < count; ++i) {
         char* id = tab_client_get_monitor_id(client, i);
         if (!id)
             continue;
         auto info = tab_client_get_monitor_info(client, id);
-        createOutput(info);
+        if (auto output = findOutputByID(id)) {
+            output->reconcile(info, client);
+            std::erase_if(stale, [output](const auto& o) { return o.get() == output; });
+        } else
+            createOutput(info);
         tab_client_free_monitor_info(&info);
         tab_client_string_free(id);
     }
 
+    for (auto const& o : stale) {
+        o->destroy();
+    }
+}
+
+bool CTabBackend::connectionLost() {
+    pollfd pfd = {.fd = tab_client_get_socket_fd(client), .events = POLLIN | POLLRDHUP, .revents = 0};
+    if (pfd.fd < 0)
+        return true;
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLRDHUP | POLLERR | POLLNVAL));
+}
+
+void CTabBackend::onDisconnected() {
+    auto core = backend.lock();
+    if (core)
+        core->log(AQ_LOG_WARNING, "tab backend: lost the connection to Shift, reconnecting");
+
+    flushCoalescedInput();
+    releaseHeldInput();
+    for (auto const& o : outputs) {
+        o->onConnectionLost();
+    }
+
+    tab_client_disconnect(client);
+    client = nullptr;
+
+    if (reconnect.timerfd < 0)
+        reconnect.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (reconnect.timerfd < 0 && core)
+        core->log(AQ_LOG_ERROR, std::format("tab backend: failed to create the reconnect timer: {}", strerror(errno)));
+
+    reconnect.backoffMs = TAB_RECONNECT_MIN_MS;
+    armReconnect();
+
     if (core)
         core->events.pollFDsChanged.emit();
+}
 
-    return true;
+void CTabBackend::armReconnect() {
+    if (reconnect.timerfd < 0)
+        return;
+
+    itimerspec ts = {.it_value = nsToTimespec(reconnect.backoffMs * 1000000ULL)};
+    if (timerfd_settime(reconnect.timerfd, 0, &ts, nullptr) && backend.lock())
+        backend.lock()->log(AQ_LOG_ERROR, std::format("tab backend: failed to arm the reconnect timer: {}", strerror(errno)));
+}
+
+void CTabBackend::tryReconnect() {
+    uint64_t expirations = 0;
+    if (read(reconnect.timerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        return;
+
+    if (client)
+        return;
+
+    const char* token = std::getenv("SHIFT_SESSION_TOKEN");
+    client            = tab_client_connect_default(token);
+    auto core         = backend.lock();
+    if (!client) {
+        reconnect.backoffMs = std::min(reconnect.backoffMs * 2, TAB_RECONNECT_MAX_MS);
+        armReconnect();
+        return;
+    }
+
+    reconnect.backoffMs = 0;
+    if (core)
+        core->log(AQ_LOG_DEBUG, "tab backend: reconnected to Shift");
+
+    syncMonitors();
+
+    if (core)
+        core->events.pollFDsChanged.emit();
 }
 
 std::vector<CSharedPointer<SPollFD>> CTabBackend::pollFDs() {
-    if (!client)
+    if (!client) {
+        if (reconnect.backoffMs && reconnect.timerfd >= 0)
+            return {CSharedPointer<SPollFD>(new SPollFD{.fd = reconnect.timerfd, .onSignal = [this]() { tryReconnect(); }})};
         return {};
+    }
     const int fd = tab_client_get_socket_fd(client);
     if (fd < 0)
         return {};
+
     return {CSharedPointer<SPollFD>(new SPollFD{.fd = fd, .onSignal = [this]() { dispatchEvents(); }})};
 }
 
@@ -370,32 +724,39 @@ bool CTabBackend::dispatchEvents() {
 
     tab_client_poll_events(client);
 
+    bool     pointerDirty = false;
+    bool     touchDirty   = false;
+
     TabEvent event {};
     while (tab_client_next_event(client, &event)) {
         switch (event.event_type) {
             case TAB_EVENT_FRAME_DONE: {
                 if (event.data.frame_done) {
-                    std::string id(event.data.frame_done);
-                    if (auto output = findOutputByID(id)) {
+                    if (auto output = findOutputByID(event.data.frame_done)) {
                         if (!output->awaitingFrameDone) {
                             break;
                         }
-                        timespec now {};
-                        clock_gettime(CLOCK_MONOTONIC, &now);
-                        output->lastPresentTime = now;
+                        clock_gettime(CLOCK_MONOTONIC, &output->lastPresentTime);
+                        ++output->presentSeq;
+
+                        output->frameScheduler->presented(output->lastPresentTime, output->refreshIntervalNs);
+
                         output->events.present.emit(IOutput::SPresentEvent{
                             .presented = true,
                             .when      = &output->lastPresentTime,
-                            .seq       = ++output->presentSeq,
+                            .seq       = output->presentSeq,
                             .refresh   = output->refreshIntervalNs,
                             .flags     = IOutput::AQ_OUTPUT_PRESENT_VSYNC,
                         });
-                        output->awaitingFrameDone = false;
-                        if (output->needsFrame && !output->frameEventScheduled) {
+                        // every swap gets its own FRAME_DONE, in order
+                        output->framesInFlight    = output->framesInFlight > 0 ? output->framesInFlight - 1 : 0;
+                        output->awaitingFrameDone = output->framesInFlight > 0;
+                        output->swapQueued(client);
+                        if (output->needsFrame && !output->frameScheduler->scheduled()) {
                             output->scheduleFrame(IOutput::AQ_SCHEDULE_NEEDS_FRAME);
                         }
                     } else if (auto core = backend.lock()) {
-                        core->log(AQ_LOG_WARNING, std::format("tab frame_done for unknown monitor {}", id));
+                        core->log(AQ_LOG_WARNING, std::format("tab frame_done for unknown monitor {}", event.data.frame_done));
                     }
                 } else if (auto core = backend.lock()) {
                     core->log(AQ_LOG_WARNING, "tab frame_done event with null monitor id");
@@ -408,25 +769,24 @@ bool CTabBackend::dispatchEvents() {
             }
             case TAB_EVENT_MONITOR_REMOVED: {
                 if (event.data.monitor_removed) {
-                    std::string id(event.data.monitor_removed);
-                    std::erase_if(outputs, [&](const auto& other) {
-                        if (other->monitorID == id) {
-                            other->destroy();
-                            return true;
-                        }
-                        return false;
-                    });
+                    if (auto output = findOutputByID(event.data.monitor_removed)) {
+                        // destroy() drops the backend's reference
+                        auto keep = output->self.lock();
+                        output->destroy();
+                    }
                 }
                 break;
             }
             case TAB_EVENT_INPUT: {
-                bool pointerDirty = false;
-                bool touchDirty   = false;
                 handleInput(&event.data.input, pointerDirty, touchDirty);
-                if (pointerDirty && pointer)
-                    pointer->events.frame.emit();
-                if (touchDirty && touch)
-                    touch->events.frame.emit();
+                if (!coalesce.enabled) {
+                    if (pointerDirty && pointer)
+                        pointer->events.frame.emit();
+                    if (touchDirty && touch)
+                        touch->events.frame.emit();
+                    pointerDirty = false;
+                    touchDirty   = false;
+                }
                 break;
             }
             default: {
@@ -438,6 +798,17 @@ bool CTabBackend::dispatchEvents() {
         }
         tab_client_free_event_strings(&event);
     }
+
+    if (coalesce.enabled) {
+        flushCoalescedInput();
+        if (pointerDirty && pointer)
+            pointer->events.frame.emit();
+    }
+
+    // everything Shift sent before going away has been handled by now
+    if (connectionLost())
+        onDisconnected();
+
     return true;
 }
 
@@ -471,17 +842,21 @@ std::vector<SDRMFormat> CTabBackend::getCursorFormats() {
 }
 
 bool CTabBackend::createOutput(const TabMonitorInfo& monitor_info) {
-    auto output = CSharedPointer<CTabOutput>(new CTabOutput(monitor_info, self));
-    output->self = output;
-    output->frameIdle = makeShared<std::function<void(void)>>([w = output->self]() {
-        if (auto o = w.lock()) {
-            o->frameEventScheduled = false;
-            if (o->awaitingFrameDone) {
-                return;
-            }
-            o->events.frame.emit();
-        }
-    });
+    auto output    = CSharedPointer<CTabOutput>(new CTabOutput(monitor_info, self));
+    output->self   = output;
+    output->handle = internMonitorID(output->monitorID);
+    if (auto& slot = outputsByHandle[output->handle]; slot && slot != output) {
+        // destroy() drops the backend's reference
+        auto keep = slot;
+        keep->destroy();
+    }
+    outputsByHandle[output->handle] = output;
+    output->frameScheduler = makeShared<CFrameScheduler>(
+        backend, [o = output.get()]() { return o->canStartFrame(); }, [o = output.get()]() { o->events.frame.emit(); });
+    output->frameScheduler->self = output->frameScheduler;
+    // opt-in late frame start: frame is delayed until the last point it can still make the next vblank, after our render and Shift's composition
+    if (renderDeadline)
+        output->frameScheduler->setTiming(CFrameScheduler::AQ_FRAME_TIMING_ADAPTIVE, TAB_DEADLINE_SLACK_NS);
     outputs.emplace_back(output);
     if (auto core = backend.lock())
         core->events.newOutput.emit(output);
@@ -500,8 +875,75 @@ CWeakPointer<IBackendImplementation> CTabBackend::getPrimary() {
     return self;
 }
 
+CSharedPointer<ITabletTool> CTabBackend::ensureTabletTool() {
+    // Shift doesn't tell tools apart, every tablet event comes from the same one
+    if (tabletTool)
+        return tabletTool;
+
+    tabletTool = CSharedPointer<ITabletTool>(new CTabTabletTool());
+    if (auto core = backend.lock())
+        core->events.newTabletTool.emit(tabletTool);
+    return tabletTool;
+}
+
+void CTabBackend::flushCoalescedInput() {
+    if (!pointer)
+        return;
+
+    if (coalesce.move) {
+        pointer->events.move.emit(*coalesce.move);
+        coalesce.move.reset();
+    }
+
+    if (coalesce.axis) {
+        pointer->events.axis.emit(*coalesce.axis);
+        coalesce.axis.reset();
+    }
+}
+
+void CTabBackend::releaseHeldInput() {
+    // the releases for these went away with Shift, without them the compositor would see them stuck
+    timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const uint32_t NOW_MS = (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+
+    if (keyboard) {
+        for (auto const& key : held.keys) {
+            keyboard->events.key.emit(IKeyboard::SKeyEvent{.timeMs = NOW_MS, .key = key, .pressed = false});
+        }
+    }
+
+    if (pointer && !held.buttons.empty()) {
+        for (auto const& button : held.buttons) {
+            pointer->events.button.emit(IPointer::SButtonEvent{.timeMs = NOW_MS, .button = button, .pressed = false});
+        }
+        pointer->events.frame.emit();
+    }
+
+    held.keys.clear();
+    held.buttons.clear();
+}
+
 void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& touchDirty) {
     auto core = backend.lock();
+
+    if (coalesce.enabled) {
+        // only consecutive relative motion, or consecutive scrolling on the same axis in the same direction, can be merged.
+        // Anything else, including the zero-delta event that stops a scroll, flushes what we have so that nothing gets reordered.
+        bool mergeable = false;
+        if (event->kind == TAB_INPUT_KIND_POINTER_MOTION)
+            mergeable = !coalesce.axis;
+        else if (event->kind == TAB_INPUT_KIND_POINTER_AXIS) {
+            const auto ev  = axisEventFromTab(event->data.pointer_axis);
+            const int  DIR = axisDirection(ev);
+            mergeable      = DIR != 0 && !coalesce.move &&
+                (!coalesce.axis || (coalesce.axis->axis == ev.axis && coalesce.axis->source == ev.source && axisDirection(*coalesce.axis) == DIR));
+        }
+
+        if (!mergeable)
+            flushCoalescedInput();
+    }
+
     switch (event->kind) {
         case TAB_INPUT_KIND_KEY: {
             if (!keyboard) {
@@ -510,6 +952,11 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newKeyboard.emit(keyboard);
             }
             auto& key = event->data.key;
+            if (key.state == TAB_KEY_PRESSED) {
+                if (std::ranges::find(held.keys, key.key) == held.keys.end())
+                    held.keys.emplace_back(key.key);
+            } else
+                std::erase(held.keys, key.key);
             keyboard->events.key.emit(IKeyboard::SKeyEvent{
                 .timeMs  = (uint32_t)(key.time_usec / 1000),
                 .key     = key.key,
@@ -524,6 +971,11 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newPointer.emit(pointer);
             }
             auto& button = event->data.pointer_button;
+            if (button.state == TAB_BUTTON_PRESSED) {
+                if (std::ranges::find(held.buttons, button.button) == held.buttons.end())
+                    held.buttons.emplace_back(button.button);
+            } else
+                std::erase(held.buttons, button.button);
             pointer->events.button.emit(IPointer::SButtonEvent{
                 .timeMs  = (uint32_t)(button.time_usec / 1000),
                 .button  = button.button,
@@ -538,12 +990,21 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                 if (core)
                     core->events.newPointer.emit(pointer);
             }
-            auto& motion = event->data.pointer_motion;
-            pointer->events.move.emit(IPointer::SMoveEvent{
-                .timeMs = (uint32_t)(motion.time_usec / 1000),
-                .delta  = {motion.dx, motion.dy},
+            auto&                      motion = event->data.pointer_motion;
+            const IPointer::SMoveEvent ev{
+                .timeMs  = (uint32_t)(motion.time_usec / 1000),
+                .delta   = {motion.dx, motion.dy},
                 .unaccel = {motion.unaccel_dx, motion.unaccel_dy},
-            });
+            };
+            if (coalesce.enabled) {
+                if (coalesce.move) {
+                    coalesce.move->timeMs  = ev.timeMs;
+                    coalesce.move->delta   = coalesce.move->delta + ev.delta;
+                    coalesce.move->unaccel = coalesce.move->unaccel + ev.unaccel;
+                } else
+                    coalesce.move = ev;
+            } else
+                pointer->events.move.emit(ev);
             pointerDirty = true;
             break;
         }
@@ -567,19 +1028,17 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                 if (core)
                     core->events.newPointer.emit(pointer);
             }
-            auto& axis = event->data.pointer_axis;
-            IPointer::SAxisEvent ev;
-            ev.timeMs = (uint32_t)(axis.time_usec / 1000);
-            ev.axis   = axis.orientation == TAB_AXIS_VERTICAL ? IPointer::AQ_POINTER_AXIS_VERTICAL : IPointer::AQ_POINTER_AXIS_HORIZONTAL;
-            switch (axis.source) {
-                case TAB_AXIS_SOURCE_WHEEL: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_WHEEL; break;
-                case TAB_AXIS_SOURCE_FINGER: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_FINGER; break;
-                case TAB_AXIS_SOURCE_CONTINUOUS: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_CONTINUOUS; break;
-                case TAB_AXIS_SOURCE_WHEEL_TILT: ev.source = IPointer::AQ_POINTER_AXIS_SOURCE_TILT; break;
-            }
-            ev.delta    = axis.delta;
-            ev.discrete = axis.delta_discrete;
-            pointer->events.axis.emit(ev);
+            const auto ev = axisEventFromTab(event->data.pointer_axis);
+            if (coalesce.enabled && axisDirection(ev) != 0) {
+                // handleInput already flushed a pending axis event of a different axis, source or direction
+                if (coalesce.axis) {
+                    coalesce.axis->timeMs = ev.timeMs;
+                    coalesce.axis->delta += ev.delta;
+                    coalesce.axis->discrete += ev.discrete;
+                } else
+                    coalesce.axis = ev;
+            } else
+                pointer->events.axis.emit(ev);
             pointerDirty = true;
             break;
         }
@@ -628,9 +1087,9 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
             break;
         }
         case TAB_INPUT_KIND_TOUCH_FRAME: {
+            // touch isn't coalesced, every frame Shift sends is passed on as is
             if (touch)
                 touch->events.frame.emit();
-            touchDirty = true;
             break;
         }
         case TAB_INPUT_KIND_TOUCH_CANCEL: {
@@ -654,7 +1113,7 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newTablet.emit(tablet);
             }
             auto& axis = event->data.tablet_tool_axis;
-            auto  tool = CSharedPointer<ITabletTool>(new CTabTabletTool());
+            auto  tool = ensureTabletTool();
             tablet->events.axis.emit(ITablet::SAxisEvent{
                 .tool     = tool,
                 .timeMs   = (uint32_t)(axis.time_usec / 1000),
@@ -673,7 +1132,7 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newTablet.emit(tablet);
             }
             auto& proximity = event->data.tablet_tool_proximity;
-            auto  tool      = CSharedPointer<ITabletTool>(new CTabTabletTool());
+            auto  tool      = ensureTabletTool();
             tablet->events.proximity.emit(ITablet::SProximityEvent{
                 .tool   = tool,
                 .timeMs = (uint32_t)(proximity.time_usec / 1000),
@@ -688,7 +1147,7 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newTablet.emit(tablet);
             }
             auto& tip  = event->data.tablet_tool_tip;
-            auto  tool = CSharedPointer<ITabletTool>(new CTabTabletTool());
+            auto  tool = ensureTabletTool();
             tablet->events.tip.emit(ITablet::STipEvent{
                 .tool   = tool,
                 .timeMs = (uint32_t)(tip.time_usec / 1000),
@@ -703,7 +1162,7 @@ void CTabBackend::handleInput(TabInputEvent* event, bool& pointerDirty, bool& to
                     core->events.newTablet.emit(tablet);
             }
             auto& button = event->data.tablet_tool_button;
-            auto  tool   = CSharedPointer<ITabletTool>(new CTabTabletTool());
+            auto  tool   = ensureTabletTool();
             tablet->events.button.emit(ITablet::SButtonEvent{
                 .tool   = tool,
                 .timeMs = (uint32_t)(button.time_usec / 1000),
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <aquamarine/backend/Wayland.hpp>
+#include <aquamarine/output/FrameScheduler.hpp>
 #include <wayland.hpp>
 #include <xdg-shell.hpp>
 #include "Shared.hpp"
@@ -61,6 +62,14 @@ wl_shm_format shmFormatFromDRM(uint32_t drmFormat) {
     return (wl_shm_format)drmFormat;
 }
 
+static uint32_t drmFormatFromSHM(wl_shm_format shmFormat) {
+    switch (shmFormat) {
+        case WL_SHM_FORMAT_XRGB8888: return DRM_FORMAT_XRGB8888;
+        case WL_SHM_FORMAT_ARGB8888: return DRM_FORMAT_ARGB8888;
+        default: return (uint32_t)shmFormat;
+    }
+}
+
 Aquamarine::CWaylandBackend::~CWaylandBackend() {
     if (drmState.fd >= 0)
         close(drmState.fd);
@@ -110,12 +119,13 @@ bool Aquamarine::CWaylandBackend::start() {
         } else if (NAME == "wl_shm") {
             TRACE(backend->log(AQ_LOG_TRACE, std::format("  > binding to global: {} (version {}) with id {}", name, 1, id)));
             waylandState.shm = makeShared<CCWlShm>((wl_proxy*)wl_registry_bind((wl_registry*)waylandState.registry->resource(), id, &wl_shm_interface, 1));
+            initShm();
         } else if (NAME == "zwp_linux_dmabuf_v1") {
             TRACE(backend->log(AQ_LOG_TRACE, std::format("  > binding to global: {} (version {}) with id {}", name, 4, id)));
             waylandState.dmabuf =
                 makeShared<CCZwpLinuxDmabufV1>((wl_proxy*)wl_registry_bind((wl_registry*)waylandState.registry->resource(), id, &zwp_linux_dmabuf_v1_interface, 4));
             if (!initDmabuf()) {
-                backend->log(AQ_LOG_ERROR, "Wayland backend cannot start: zwp_linux_dmabuf_v1 init failed");
+                backend->log(AQ_LOG_ERROR, "zwp_linux_dmabuf_v1 init failed, falling back to wl_shm buffers");
                 waylandState.dmabufFailed = true;
             }
         }
@@ -124,11 +134,15 @@ bool Aquamarine::CWaylandBackend::start() {
 
     wl_display_roundtrip(waylandState.display);
 
-    if (!waylandState.xdg || !waylandState.compositor || !waylandState.seat || !waylandState.dmabuf || waylandState.dmabufFailed || !waylandState.shm) {
+    if (!waylandState.xdg || !waylandState.compositor || !waylandState.seat || !waylandState.shm) {
         backend->log(AQ_LOG_ERROR, "Wayland backend cannot start: Missing protocols");
         return false;
     }
 
+    // without a drm device, buffers come from the shm allocator and go through wl_shm
+    if (!waylandState.dmabuf || waylandState.dmabufFailed || drmState.fd < 0)
+        backend->log(AQ_LOG_DEBUG, "Wayland backend has no drm device, using wl_shm buffers");
+
     dispatchEvents();
 
     createOutput();
@@ -337,6 +351,17 @@ void Aquamarine::CWaylandBackend::initShell() {
     waylandState.xdg->setPing([](CCXdgWmBase* r, uint32_t serial) { r->sendPong(serial); });
 }
 
+void Aquamarine::CWaylandBackend::initShm() {
+    waylandState.shm->setFormat([this](CCWlShm* r, wl_shm_format format) {
+        const auto FORMAT = drmFormatFromSHM(format);
+        if (std::ranges::any_of(shmFormats, [FORMAT](const auto& e) { return e.drmFormat == FORMAT; }))
+            return;
+
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("wl_shm: Got format {}", fourccToName(FORMAT))));
+        shmFormats.emplace_back(SDRMFormat{.drmFormat = FORMAT, .modifiers = {DRM_FORMAT_MOD_LINEAR}});
+    });
+}
+
 bool Aquamarine::CWaylandBackend::initDmabuf() {
     waylandState.dmabufFeedback = makeShared<CCZwpLinuxDmabufFeedbackV1>(waylandState.dmabuf->sendGetDefaultFeedback());
     if (!waylandState.dmabufFeedback) {
@@ -439,11 +464,11 @@ bool Aquamarine::CWaylandBackend::initDmabuf() {
 }
 
 std::vector<SDRMFormat> Aquamarine::CWaylandBackend::getRenderFormats() {
-    return dmabufFormats;
+    return drmState.fd >= 0 ? dmabufFormats : shmFormats;
 }
 
 std::vector<SDRMFormat> Aquamarine::CWaylandBackend::getCursorFormats() {
-    return dmabufFormats;
+    return drmState.fd >= 0 ? dmabufFormats : shmFormats;
 }
 
 SP<IAllocator> Aquamarine::CWaylandBackend::preferredAllocator() {
@@ -461,6 +486,10 @@ Hyprutils::Memory::CWeakPointer<IBackendImplementation> Aquamarine::CWaylandBack
 Aquamarine::CWaylandOutput::CWaylandOutput(const std::string& name_, Hyprutils::Memory::CWeakPointer<CWaylandBackend> backend_) : backend(backend_) {
     name = name_;
 
+    // the parent compositor paces us with frame callbacks, a frame waits while one is pending
+    frameScheduler       = makeShared<CFrameScheduler>(backend->backend, [this]() { return !waylandState.frameCallback; }, [this]() { sendFrameAndSetCallback(); });
+    frameScheduler->self = frameScheduler;
+
     waylandState.surface = makeShared<CCWlSurface>(backend->waylandState.compositor->sendCreateSurface());
 
     if (!waylandState.surface->resource()) {
@@ -519,6 +548,7 @@ Aquamarine::CWaylandOutput::CWaylandOutput(const std::string& name_, Hyprutils::
 }
 
 Aquamarine::CWaylandOutput::~CWaylandOutput() {
+    frameScheduler.reset();
     events.destroy.emit();
     if (waylandState.xdgToplevel)
         waylandState.xdgToplevel->sendDestroy();
@@ -599,7 +629,8 @@ bool Aquamarine::CWaylandOutput::commit() {
     if (wlBuffer->pendingRelease)
         backend->backend->log(AQ_LOG_WARNING, std::format("Output {}: pending state has a non-released buffer??", name));
 
-    wlBuffer->pendingRelease = true;
+    wlBuffer->pendingRelease                     = true;
+    state->internalState.buffer->lockedByBackend = true;
 
     waylandState.surface->sendAttach(wlBuffer->waylandState.buffer.get(), 0, 0);
     waylandState.surface->sendDamageBuffer(0, 0, INT32_MAX, INT32_MAX);
@@ -607,6 +638,10 @@ bool Aquamarine::CWaylandOutput::commit() {
 
     readyForFrameCallback = true;
 
+    // feeds the swapchain's buffer ages, no damage committed means we don't know what changed
+    swapchain->presented(state->internalState.buffer,
+                         (state->internalState.committed & COutputState::AQ_OUTPUT_STATE_DAMAGE) ? state->internalState.damage : CRegion{0, 0, pixelSize.x, pixelSize.y});
+
     events.commit.emit();
     state->onCommit();
     needsFrame = false;
@@ -647,7 +682,6 @@ SP<CWaylandBuffer> Aquamarine::CWaylandOutput::wlBufferFromBuffer(SP<IBuffer> bu
 
 void Aquamarine::CWaylandOutput::sendFrameAndSetCallback() {
     events.frame.emit();
-    frameScheduled = false;
     if (waylandState.frameCallback || !readyForFrameCallback)
         return;
 
@@ -664,14 +698,14 @@ void Aquamarine::CWaylandOutput::onFrameDone() {
 
     // FIXME: this is wrong, but otherwise we get bugs.
     // thanks @phonetic112
-    scheduleFrame(AQ_SCHEDULE_NEEDS_FRAME);
-
-    if (frameScheduledWhileWaiting)
-        sendFrameAndSetCallback();
-    else
+    if (frameScheduler->pending()) {
+        // scheduled while waiting for the callback
+        needsFrame = true;
+        frameScheduler->dispatch(AQ_SCHEDULE_NEEDS_FRAME);
+    } else {
+        scheduleFrame(AQ_SCHEDULE_NEEDS_FRAME);
         events.frame.emit();
-
-    frameScheduledWhileWaiting = false;
+    }
 }
 
 bool Aquamarine::CWaylandOutput::setCursor(Hyprutils::Memory::CSharedPointer<IBuffer> buffer, const Hyprutils::Math::Vector2D& hotspot) {
@@ -776,46 +810,70 @@ Hyprutils::Math::Vector2D Aquamarine::CWaylandOutput::cursorPlaneSize() {
 
 void Aquamarine::CWaylandOutput::scheduleFrame(const scheduleFrameReason reason) {
     TRACE(backend->backend->log(AQ_LOG_TRACE,
-                                std::format("CWaylandOutput::scheduleFrame: reason {}, needsFrame {}, frameScheduled {}", (uint32_t)reason, needsFrame, frameScheduled)));
+                                std::format("CWaylandOutput::scheduleFrame: reason {}, needsFrame {}, frameScheduled {}", (uint32_t)reason, needsFrame, frameScheduler->scheduled())));
     needsFrame = true;
+    frameScheduler->schedule(reason);
+}
 
-    if (frameScheduled)
-        return;
+Aquamarine::CWaylandBuffer::CWaylandBuffer(SP<IBuffer> buffer_, Hyprutils::Memory::CWeakPointer<CWaylandBackend> backend_) : buffer(buffer_), backend(backend_) {
+    if (buffer_->type() == BUFFER_TYPE_SHM) {
+        auto attrs = buffer_->shm();
+        if (!attrs.success) {
+            backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: shm buffer has no attrs");
+            return;
+        }
+
+        // the buffer keeps its memfd and mapping, the host maps the same pages
+        auto pool = makeShared<CCWlShmPool>(backend->waylandState.shm->sendCreatePool(attrs.fd, attrs.offset + (int64_t)attrs.stride * (int64_t)attrs.size.y));
+        if (!pool) {
+            backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: failed to create a wl_shm pool");
+            return;
+        }
 
-    frameScheduled = true;
+        waylandState.buffer = makeShared<CCWlBuffer>(pool->sendCreateBuffer(attrs.offset, attrs.size.x, attrs.size.y, attrs.stride, shmFormatFromDRM(attrs.format)));
+        pool.reset();
+    } else {
+        if (!backend->waylandState.dmabuf || backend->waylandState.dmabufFailed) {
+            backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: cannot import a dmabuf without zwp_linux_dmabuf_v1");
+            return;
+        }
 
-    if (waylandState.frameCallback)
-        frameScheduledWhileWaiting = true;
-    else {
-        backend->idleCallbacks.emplace_back([w = self]() {
-            if (auto o = w.lock())
-                o->sendFrameAndSetCallback();
-        });
-    }
-}
+        auto params = makeShared<CCZwpLinuxBufferParamsV1>(backend->waylandState.dmabuf->sendCreateParams());
 
-Aquamarine::CWaylandBuffer::CWaylandBuffer(SP<IBuffer> buffer_, Hyprutils::Memory::CWeakPointer<CWaylandBackend> backend_) : buffer(buffer_), backend(backend_) {
-    auto params = makeShared<CCZwpLinuxBufferParamsV1>(backend->waylandState.dmabuf->sendCreateParams());
+        if (!params) {
+            backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: failed to query params");
+            return;
+        }
 
-    if (!params) {
-        backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: failed to query params");
-        return;
-    }
+        auto attrs = buffer->dmabuf();
 
-    auto attrs = buffer->dmabuf();
+        for (int i = 0; i < attrs.planes; ++i) {
+            params->sendAdd(attrs.fds.at(i), i, attrs.offsets.at(i), attrs.strides.at(i), attrs.modifier >> 32, attrs.modifier & 0xFFFFFFFF);
+        }
 
-    for (int i = 0; i < attrs.planes; ++i) {
-        params->sendAdd(attrs.fds.at(i), i, attrs.offsets.at(i), attrs.strides.at(i), attrs.modifier >> 32, attrs.modifier & 0xFFFFFFFF);
+        waylandState.buffer = makeShared<CCWlBuffer>(params->sendCreateImmed(attrs.size.x, attrs.size.y, attrs.format, (zwpLinuxBufferParamsV1Flags)0));
+        params->sendDestroy();
     }
 
-    waylandState.buffer = makeShared<CCWlBuffer>(params->sendCreateImmed(attrs.size.x, attrs.size.y, attrs.format, (zwpLinuxBufferParamsV1Flags)0));
-
-    waylandState.buffer->setRelease([this](CCWlBuffer* r) { pendingRelease = false; });
+    if (!waylandState.buffer) {
+        backend->backend->log(AQ_LOG_ERROR, "WaylandBuffer: failed to create a wl_buffer");
+        return;
+    }
 
-    params->sendDestroy();
+    waylandState.buffer->setRelease([this](CCWlBuffer* r) {
+        pendingRelease = false;
+        if (auto buf = buffer.lock()) {
+            buf->lockedByBackend = false;
+            buf->events.backendRelease.emit();
+        }
+    });
 }
 
 Aquamarine::CWaylandBuffer::~CWaylandBuffer() {
+    // the host can't hold on to a destroyed wl_buffer
+    if (auto buf = buffer.lock(); buf && pendingRelease)
+        buf->lockedByBackend = false;
+
     if (waylandState.buffer && waylandState.buffer->resource())
         waylandState.buffer->sendDestroy();
 }
@@ -3,6 +3,7 @@
 #include <aquamarine/backend/DRM.hpp>
 #include <aquamarine/backend/drm/Legacy.hpp>
 #include <aquamarine/backend/drm/Atomic.hpp>
+#include <aquamarine/output/FrameScheduler.hpp>
 #include <aquamarine/allocator/GBM.hpp>
 #include <aquamarine/allocator/DRMDumb.hpp>
 #include <cstdint>
@@ -945,18 +946,24 @@ static void handlePF(int fd, unsigned seq, unsigned tv_sec, unsigned tv_usec, un
 
     uint32_t flags = IOutput::AQ_OUTPUT_PRESENT_VSYNC | IOutput::AQ_OUTPUT_PRESENT_HW_CLOCK | IOutput::AQ_OUTPUT_PRESENT_HW_COMPLETION | IOutput::AQ_OUTPUT_PRESENT_ZEROCOPY;
 
-    timespec presented = {.tv_sec = (time_t)tv_sec, .tv_nsec = (long)(tv_usec * 1000)};
+    timespec   presented = {.tv_sec = (time_t)tv_sec, .tv_nsec = (long)(tv_usec * 1000)};
+    const auto REFRESHNS = pageFlip->connector->refresh ? (1000000000000LL / pageFlip->connector->refresh) : 0;
+    // the output can go away in a present handler, and its scheduler with it
+    const auto SCHEDULER = pageFlip->connector->output->getFrameScheduler();
+
+    // with VRR the next vblank follows the next commit, there's nothing to predict
+    SCHEDULER->presented(presented, pageFlip->connector->output->vrrActive ? 0 : REFRESHNS);
 
     pageFlip->connector->output->events.present.emit(IOutput::SPresentEvent{
         .presented = BACKEND->sessionActive(),
         .when      = &presented,
         .seq       = seq,
-        .refresh   = (int)(pageFlip->connector->refresh ? (1000000000000LL / pageFlip->connector->refresh) : 0),
+        .refresh   = (int)REFRESHNS,
         .flags     = flags,
     });
 
-    if (BACKEND->sessionActive() && !pageFlip->connector->frameEventScheduled && pageFlip->connector->output->enabledState)
-        pageFlip->connector->output->events.frame.emit();
+    if (SCHEDULER && BACKEND->sessionActive() && !SCHEDULER->scheduled() && pageFlip->connector->output->enabledState)
+        SCHEDULER->dispatch(IOutput::AQ_SCHEDULE_NEEDS_FRAME);
 }
 
 bool Aquamarine::CDRMBackend::dispatchEvents() {
@@ -1572,10 +1579,8 @@ void Aquamarine::SDRMConnector::onPresent() {
 }
 
 Aquamarine::CDRMOutput::~CDRMOutput() {
-    if (backend && backend->backend)
-        backend->backend->removeIdleEvent(frameIdle);
-    connector->isPageFlipPending   = false;
-    connector->frameEventScheduled = false;
+    frameScheduler.reset();
+    connector->isPageFlipPending = false;
 }
 
 bool Aquamarine::CDRMOutput::commit() {
@@ -1825,11 +1830,18 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
     if (onlyTest || !ok)
         return ok;
 
+    // feeds the swapchain's buffer ages, no damage committed means we don't know what changed
+    if (swapchain && STATE.buffer && (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_BUFFER)) {
+        const auto& SIZE = swapchain->currentOptions().size;
+        swapchain->presented(STATE.buffer, (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_DAMAGE) ? STATE.damage : CRegion{0, 0, SIZE.x, SIZE.y});
+    }
+
     events.commit.emit();
     state->onCommit();
 
     lastCommitNoBuffer = !data.mainFB;
     needsFrame         = false;
+    frameScheduler->committed();
 
     if (ok)
         connector->commitTainted = false;
@@ -1844,6 +1856,7 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
 
         timespec presented;
         clock_gettime(CLOCK_MONOTONIC, &presented);
+        frameScheduler->presented(presented, 0);
 
         connector->output->events.present.emit(IOutput::SPresentEvent{
             .presented = backend->sessionActive(),
@@ -1954,15 +1967,9 @@ void Aquamarine::CDRMOutput::moveCursor(const Vector2D& coord, bool skipSchedule
 void Aquamarine::CDRMOutput::scheduleFrame(const scheduleFrameReason reason) {
     TRACE(backend->backend->log(AQ_LOG_TRACE,
                                 std::format("CDRMOutput::scheduleFrame: reason {}, needsFrame {}, isPageFlipPending {}, frameEventScheduled {}", (uint32_t)reason, needsFrame,
-                                            connector->isPageFlipPending, connector->frameEventScheduled)));
+                                            connector->isPageFlipPending, frameScheduler->scheduled())));
     needsFrame = true;
-
-    if (connector->isPageFlipPending || connector->frameEventScheduled || !enabledState)
-        return;
-
-    connector->frameEventScheduled = true;
-
-    backend->backend->addIdleEvent(frameIdle);
+    frameScheduler->schedule(reason);
 }
 
 Vector2D Aquamarine::CDRMOutput::cursorPlaneSize() {
@@ -2015,12 +2022,9 @@ Aquamarine::CDRMOutput::CDRMOutput(const std::string& name_, Hyprutils::Memory::
     backend(backend_), connector(connector_) {
     name = name_;
 
-    frameIdle = makeShared<std::function<void(void)>>([this]() {
-        connector->frameEventScheduled = false;
-        if (connector->isPageFlipPending)
-            return;
-        events.frame.emit();
-    });
+    frameScheduler = makeShared<CFrameScheduler>(
+        backend->backend, [this]() { return !connector->isPageFlipPending && enabledState; }, [this]() { events.frame.emit(); });
+    frameScheduler->self = frameScheduler;
 }
 
 SP<CDRMFB> Aquamarine::CDRMFB::create(SP<IBuffer> buffer_, Hyprutils::Memory::CWeakPointer<CDRMBackend> backend_, bool* isNew) {
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace Aquamarine {
+    // A fixed-size single-producer, single-consumer ring. push() must only be called from one thread,
+    // pop() from one (other) thread. Neither ever blocks or allocates, so T should be plain data.
+    template <typename T, size_t N>
+    class CSPSCRing {
+        static_assert(N && (N & (N - 1)) == 0, "CSPSCRing size must be a power of two");
+
+      public:
+        // false if the ring is full
+        bool push(const T& value) {
+            const size_t HEAD = head.load(std::memory_order_relaxed);
+            if (HEAD - cachedTail == N) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (HEAD - cachedTail == N)
+                    return false;
+            }
+
+            slots[HEAD & (N - 1)] = value;
+            head.store(HEAD + 1, std::memory_order_release);
+            return true;
+        }
+
+        // false if the ring is empty
+        bool pop(T& value) {
+            const size_t TAIL = tail.load(std::memory_order_relaxed);
+            if (TAIL == cachedHead) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (TAIL == cachedHead)
+                    return false;
+            }
+
+            value = slots[TAIL & (N - 1)];
+            tail.store(TAIL + 1, std::memory_order_release);
+            return true;
+        }
+
+      private:
+        // keep the producer's and the consumer's indices on separate cache lines
+        alignas(64) std::atomic<size_t> head = 0; // producer
+        size_t                          cachedTail = 0;
+        alignas(64) std::atomic<size_t> tail       = 0; // consumer
+        size_t                          cachedHead = 0;
+        alignas(64) std::array<T, N> slots;
+    };
+};
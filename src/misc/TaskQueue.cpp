@@ -0,0 +1,125 @@
+#include <aquamarine/misc/TaskQueue.hpp>
+#include <cstdint>
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace Aquamarine;
+
+// Vyukov's intrusive MPSC queue. Producers only ever touch head, the consumer owns tail.
+
+Aquamarine::CTaskQueue::CTaskQueue() : head(&stub), tail(&stub) {
+    eventFD = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+Aquamarine::CTaskQueue::~CTaskQueue() {
+    // whatever is left is dropped without running
+    while (auto node = pop()) {
+        delete node;
+    }
+
+    if (eventFD >= 0)
+        close(eventFD);
+}
+
+int Aquamarine::CTaskQueue::fd() const {
+    return eventFD;
+}
+
+void Aquamarine::CTaskQueue::link(SNode* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    SNode* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+}
+
+void Aquamarine::CTaskQueue::push(std::function<void(void)>&& fn) {
+    auto node = new SNode();
+    node->fn  = std::move(fn);
+    link(node);
+
+    // one wakeup per drain is enough, it's reset right before the consumer starts popping
+    if (!signalled.exchange(true))
+        signal();
+}
+
+void Aquamarine::CTaskQueue::signal() {
+    const uint64_t ONE = 1;
+    if (eventFD >= 0 && write(eventFD, &ONE, sizeof(ONE)) < 0)
+        return;
+}
+
+Aquamarine::CTaskQueue::SNode* Aquamarine::CTaskQueue::pop() {
+    SNode* t    = tail;
+    SNode* next = t->next.load(std::memory_order_acquire);
+
+    if (t == &stub) {
+        if (!next)
+            return nullptr;
+        tail = next;
+        t    = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail = next;
+        return t;
+    }
+
+    // a producer swapped head but hasn't linked its node yet, it will signal again
+    if (t != head.load(std::memory_order_acquire))
+        return nullptr;
+
+    link(&stub);
+
+    next = t->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return t;
+    }
+
+    return nullptr;
+}
+
+size_t Aquamarine::CTaskQueue::drain(size_t maxTasks) {
+    uint64_t count = 0;
+    if (read(eventFD, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return 0;
+
+    signalled.store(false);
+
+    size_t ran = 0;
+    while (ran < maxTasks) {
+        auto node = pop();
+        if (!node)
+            break;
+
+        if (node->fn)
+            node->fn();
+        delete node;
+        ++ran;
+    }
+
+    // leave the rest for the next wakeup so that other fds get a turn
+    if (ran == maxTasks && !signalled.exchange(true))
+        signal();
+
+    return ran;
+}
+
+Aquamarine::CTaskGate::CTaskGate(CTaskQueue* queue_) : queue(queue_) {
+    ;
+}
+
+bool Aquamarine::CTaskGate::post(std::function<void(void)>& fn) {
+    std::lock_guard<std::mutex> lg(lock);
+    if (!queue)
+        return false;
+
+    queue->push(std::move(fn));
+    return true;
+}
+
+void Aquamarine::CTaskGate::close() {
+    std::lock_guard<std::mutex> lg(lock);
+    queue = nullptr;
+}
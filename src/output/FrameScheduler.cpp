@@ -0,0 +1,225 @@
+#include <aquamarine/output/FrameScheduler.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <algorithm>
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+
+#define TIMESPEC_NSEC_PER_SEC 1000000000LL
+
+// not worth arming a timer for less than this, the frame goes out right away instead
+constexpr uint64_t FRAME_TIMER_MIN_DELAY_NS = 500000;
+
+// how much the presentation latency estimate grows past the slack of a frame that missed its vblank
+constexpr uint64_t FRAME_LATENCY_STEP_NS = 500000;
+
+static uint64_t timespecToNs(const timespec& ts) {
+    return (uint64_t)ts.tv_sec * TIMESPEC_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t monotonicNowNs() {
+    timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecToNs(now);
+}
+
+Aquamarine::CFrameScheduler::CFrameScheduler(CWeakPointer<CBackend> backend_, std::function<bool()> canFrame_, std::function<void()> onFrame_) :
+    backend(backend_), canFrame(std::move(canFrame_)), onFrame(std::move(onFrame_)) {
+    ;
+}
+
+Aquamarine::CFrameScheduler::~CFrameScheduler() {
+    cancel();
+}
+
+void Aquamarine::CFrameScheduler::schedule(IOutput::scheduleFrameReason reason) {
+    mergedReasons |= 1U << (reason & 31);
+    wanted = true;
+
+    if (armed || (canFrame && !canFrame()))
+        return;
+
+    arm();
+}
+
+void Aquamarine::CFrameScheduler::dispatch(IOutput::scheduleFrameReason reason) {
+    mergedReasons |= 1U << (reason & 31);
+    wanted = true;
+
+    if (canFrame && !canFrame())
+        return;
+
+    if (targetNs() > monotonicNowNs() + FRAME_TIMER_MIN_DELAY_NS) {
+        if (!armed)
+            arm();
+        return;
+    }
+
+    cancel();
+    armed = true;
+    fire();
+}
+
+void Aquamarine::CFrameScheduler::cancel() {
+    frameEmittedNs = 0;
+
+    if (!armed)
+        return;
+
+    armed = false;
+
+    auto be = backend.lock();
+    if (!be)
+        return;
+
+    be->removeIdleEvent(idle);
+    if (timerArmed)
+        be->removeTimer(timer);
+    timerArmed = false;
+}
+
+void Aquamarine::CFrameScheduler::arm() {
+    auto be = backend.lock();
+    if (!be)
+        return;
+
+    // the backend may still run a callback it already took off its queue after we're gone, so they only hold a weak ref
+    if (!idle) {
+        idle  = makeShared<std::function<void(void)>>([w = self]() {
+            if (auto s = w.lock())
+                s->fire();
+        });
+        timer = makeShared<std::function<void(void)>>([w = self]() {
+            if (auto s = w.lock()) {
+                s->timerArmed = false;
+                s->fire();
+            }
+        });
+    }
+
+    armed = true;
+
+    const uint64_t TARGET = targetNs();
+    if (TARGET > monotonicNowNs() + FRAME_TIMER_MIN_DELAY_NS) {
+        timerArmed = true;
+        be->addTimerAt(timer, TARGET);
+        return;
+    }
+
+    be->addIdleEvent(idle);
+}
+
+void Aquamarine::CFrameScheduler::fire() {
+    // a stale idle or timer, already cancelled
+    if (!armed)
+        return;
+
+    armed = false;
+
+    // the request stays, the output schedules again once it can take a frame
+    if (canFrame && !canFrame())
+        return;
+
+    wanted         = false;
+    lastReasons    = mergedReasons;
+    mergedReasons  = 0;
+    frameEmittedNs = monotonicNowNs();
+
+    // nothing after this, the frame handler may destroy the output and us with it
+    onFrame();
+}
+
+uint64_t Aquamarine::CFrameScheduler::targetNs() const {
+    if (timing == AQ_FRAME_TIMING_ASAP)
+        return 0;
+
+    const uint64_t VBLANK = predictNextVblank();
+    if (!VBLANK)
+        return 0;
+
+    // never lead by more than one refresh
+    const uint64_t BUDGET = std::min(timing == AQ_FRAME_TIMING_ADAPTIVE ? renderNs + latencyNs + offsetNs : offsetNs, refreshNs);
+    return VBLANK > BUDGET ? VBLANK - BUDGET : 0;
+}
+
+void Aquamarine::CFrameScheduler::presented(const timespec& when, uint64_t refreshNs_) {
+    lastVblankNs = timespecToNs(when);
+    refreshNs    = refreshNs_;
+
+    if (!targetVblankNs || !lastVblankNs || !refreshNs)
+        return;
+
+    // whatever comes after the commit (e.g. the display server composing) has to fit in the slack the frame had before its vblank.
+    // A miss means it didn't: grow past that. A hit only says it fit, so shrink slowly and keep probing.
+    const uint64_t SLACK = targetVblankNs > committedNs ? targetVblankNs - committedNs : 0;
+    if (lastVblankNs > targetVblankNs + refreshNs / 2)
+        latencyNs = std::max(latencyNs, SLACK) + FRAME_LATENCY_STEP_NS;
+    else
+        latencyNs -= latencyNs / 32;
+
+    targetVblankNs = 0;
+}
+
+void Aquamarine::CFrameScheduler::committed() {
+    if (!frameEmittedNs)
+        return;
+
+    const uint64_t NOW = monotonicNowNs();
+    if (timing == AQ_FRAME_TIMING_ADAPTIVE) {
+        committedNs    = NOW;
+        targetVblankNs = predictNextVblank();
+    }
+
+    // running average of how long the compositor takes from frame to commit
+    const uint64_t SAMPLE = NOW - frameEmittedNs;
+    renderNs              = renderNs ? (renderNs * 7 + SAMPLE) / 8 : SAMPLE;
+    frameEmittedNs        = 0;
+}
+
+void Aquamarine::CFrameScheduler::setTiming(eFrameTiming timing_, uint64_t offsetNs_) {
+    timing   = timing_;
+    offsetNs = offsetNs_;
+
+    // re-time a frame that's already waiting
+    if (armed) {
+        cancel();
+        arm();
+    }
+}
+
+uint64_t Aquamarine::CFrameScheduler::predictNextVblank() const {
+    if (!lastVblankNs || !refreshNs)
+        return 0;
+
+    const uint64_t NOW = monotonicNowNs();
+    if (lastVblankNs > NOW)
+        return lastVblankNs;
+
+    // next multiple of the refresh interval after the last known vblank
+    return lastVblankNs + ((NOW - lastVblankNs) / refreshNs + 1) * refreshNs;
+}
+
+bool Aquamarine::CFrameScheduler::scheduled() const {
+    return armed;
+}
+
+bool Aquamarine::CFrameScheduler::pending() const {
+    return wanted && !armed;
+}
+
+uint32_t Aquamarine::CFrameScheduler::reasons() const {
+    return mergedReasons;
+}
+
+uint32_t Aquamarine::CFrameScheduler::frameReasons() const {
+    return lastReasons;
+}
+
+uint64_t Aquamarine::CFrameScheduler::renderTimeNs() const {
+    return renderNs;
+}
+
+uint64_t Aquamarine::CFrameScheduler::presentLatencyNs() const {
+    return latencyNs;
+}
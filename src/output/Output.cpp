@@ -1,4 +1,5 @@
 #include <aquamarine/output/Output.hpp>
+#include <aquamarine/output/FrameScheduler.hpp>
 
 using namespace Aquamarine;
 
@@ -47,6 +48,10 @@ bool Aquamarine::IOutput::destroy() {
     return false;
 }
 
+Hyprutils::Memory::CWeakPointer<CFrameScheduler> Aquamarine::IOutput::getFrameScheduler() {
+    return frameScheduler;
+}
+
 const Aquamarine::COutputState::SInternalState& Aquamarine::COutputState::state() {
     return internalState;
 }
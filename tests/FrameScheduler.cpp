@@ -0,0 +1,159 @@
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/output/FrameScheduler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include "shared.hpp"
+
+using namespace Hyprutils::Memory;
+using CFrameScheduler = Aquamarine::CFrameScheduler;
+using IOutput         = Aquamarine::IOutput;
+
+constexpr uint64_t REFRESH_NS = 16666667;
+constexpr uint64_t OFFSET_NS  = 4000000;
+
+// timers are never early, but may fire a bit late on a loaded machine
+constexpr uint64_t LATE_NS = REFRESH_NS / 2;
+
+static uint64_t nowNs() {
+    timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static timespec nsToTimespec(uint64_t ns) {
+    return timespec{.tv_sec = (time_t)(ns / 1000000000ULL), .tv_nsec = (long)(ns % 1000000000ULL)};
+}
+
+// dispatch until a frame comes out, or timeoutMs passes
+static bool waitForFrame(CSharedPointer<Aquamarine::CBackend> backend, const size_t& frames, int timeoutMs) {
+    const size_t FRAMES = frames;
+    const auto   END    = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (frames == FRAMES && std::chrono::steady_clock::now() < END) {
+        backend->dispatchOnce(std::max<int>(1, std::chrono::duration_cast<std::chrono::milliseconds>(END - std::chrono::steady_clock::now()).count()));
+    }
+    return frames != FRAMES;
+}
+
+// handle whatever is ready without waiting, for checks that nothing comes out. A scheduler with nothing armed has nothing to wait for
+static bool dispatchReady(CSharedPointer<Aquamarine::CBackend> backend, const size_t& frames) {
+    const size_t FRAMES = frames;
+    backend->dispatchOnce(0);
+    return frames != FRAMES;
+}
+
+int main() {
+    int                                       ret = 0;
+
+    Aquamarine::SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = Aquamarine::eBackendType::AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = Aquamarine::eBackendRequestMode::AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend = Aquamarine::CBackend::create({nullOptions}, Aquamarine::SBackendOptions{});
+    if (!backend || !backend->start()) {
+        std::cout << "Failed to start a null backend\n";
+        return 1;
+    }
+
+    size_t   frames  = 0;
+    bool     open    = true;
+    uint64_t frameAt = 0;
+
+    auto     scheduler = makeShared<CFrameScheduler>(
+        backend, [&open]() { return open; },
+        [&frames, &frameAt]() {
+            frames++;
+            frameAt = nowNs();
+        });
+    scheduler->self = scheduler;
+
+    // requests made before the frame goes out are merged into it
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    scheduler->schedule(IOutput::AQ_SCHEDULE_CURSOR_MOVE);
+    scheduler->schedule(IOutput::AQ_SCHEDULE_ANIMATION);
+    EXPECT(scheduler->scheduled(), true);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+    EXPECT(frames, 1);
+    EXPECT(scheduler->frameReasons(), (1U << IOutput::AQ_SCHEDULE_DAMAGE) | (1U << IOutput::AQ_SCHEDULE_CURSOR_MOVE) | (1U << IOutput::AQ_SCHEDULE_ANIMATION));
+    EXPECT(scheduler->scheduled(), false);
+    EXPECT(dispatchReady(backend, frames), false);
+
+    // a closed gate holds the request until the output can take a frame
+    open = false;
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    EXPECT(scheduler->scheduled(), false);
+    EXPECT(scheduler->pending(), true);
+    EXPECT(dispatchReady(backend, frames), false);
+    open = true;
+    scheduler->dispatch(IOutput::AQ_SCHEDULE_NEEDS_FRAME);
+    EXPECT(frames, 2);
+    EXPECT(scheduler->pending(), false);
+
+    // cancelled frames never come out
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    scheduler->cancel();
+    EXPECT(scheduler->scheduled(), false);
+    EXPECT(dispatchReady(backend, frames), false);
+
+    // with a fixed offset, frame lands that long before the predicted vblank
+    timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    scheduler->presented(now, REFRESH_NS);
+    scheduler->setTiming(CFrameScheduler::AQ_FRAME_TIMING_OFFSET, OFFSET_NS);
+
+    const uint64_t VBLANK      = scheduler->predictNextVblank();
+    const uint64_t SCHEDULEDAT = nowNs();
+    EXPECT(VBLANK > SCHEDULEDAT, true);
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+    EXPECT(frameAt >= SCHEDULEDAT, true);
+
+    // OFFSET_NS before the predicted vblank, or before a later one if the test got held up before scheduling
+    const uint64_t PHASE = (frameAt + OFFSET_NS - (uint64_t)now.tv_sec * 1000000000ULL - now.tv_nsec) % REFRESH_NS;
+    EXPECT(PHASE < LATE_NS, true);
+
+    // the render time estimate follows frame -> commit
+    scheduler->committed();
+    EXPECT(scheduler->renderTimeNs() > 0, true);
+
+    // a commit that misses the vblank it was aiming for teaches adaptive timing to land earlier
+    scheduler->setTiming(CFrameScheduler::AQ_FRAME_TIMING_ADAPTIVE);
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+    scheduler->committed();
+    const uint64_t LATE = scheduler->predictNextVblank() + 2 * REFRESH_NS;
+    scheduler->presented(nsToTimespec(LATE), REFRESH_NS);
+    const uint64_t LATENCY = scheduler->presentLatencyNs();
+    EXPECT(LATENCY > 0, true);
+
+    // and one that makes it lets the estimate come back down
+    scheduler->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+    scheduler->committed();
+    scheduler->presented(nsToTimespec(scheduler->predictNextVblank()), REFRESH_NS);
+    EXPECT(scheduler->presentLatencyNs() < LATENCY, true);
+
+    // an output destroyed from another output's frame handler, with its own frame already up in the same dispatch, gets no frame
+    size_t victimFrames = 0;
+    auto   victim       = makeShared<CFrameScheduler>(backend, nullptr, [&victimFrames]() { victimFrames++; });
+    victim->self        = victim;
+    auto killer         = makeShared<CFrameScheduler>(backend, nullptr, [&victim, &frames]() {
+        frames++;
+        victim.reset();
+    });
+    killer->self        = killer;
+    killer->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    victim->schedule(IOutput::AQ_SCHEDULE_DAMAGE);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+    EXPECT(victim.get() == nullptr, true);
+    EXPECT(victimFrames, 0);
+
+    // a timer due at 0 is long overdue, not a disarmed timerfd
+    auto overdue = makeShared<std::function<void(void)>>([&frames]() { frames++; });
+    backend->addTimerAt(overdue, 0);
+    EXPECT(waitForFrame(backend, frames, 100), true);
+
+    killer.reset();
+    scheduler.reset();
+    return ret;
+}
@@ -0,0 +1,106 @@
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/backend/Null.hpp>
+#include <aquamarine/allocator/GBM.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <chrono>
+#include <format>
+#include <fcntl.h>
+#include <unistd.h>
+#include "shared.hpp"
+
+using namespace Hyprutils::Memory;
+
+// ctest's SKIP_RETURN_CODE, for when there's no gpu to allocate from
+constexpr int SKIP = 77;
+
+// render nodes are numbered from 128
+constexpr int RENDER_NODE_FIRST = 128, RENDER_NODE_COUNT = 64;
+
+static int openRenderNode() {
+    for (int i = RENDER_NODE_FIRST; i < RENDER_NODE_FIRST + RENDER_NODE_COUNT; ++i) {
+        if (int fd = open(std::format("/dev/dri/renderD{}", i).c_str(), O_RDWR | O_CLOEXEC); fd >= 0)
+            return fd;
+    }
+    return -1;
+}
+
+// Background allocations on the gbm allocator's worker device. Runs on the first render node there is, and is skipped without one.
+int main() {
+    int                                       ret = 0;
+
+    Aquamarine::SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = Aquamarine::eBackendType::AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = Aquamarine::eBackendRequestMode::AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend = Aquamarine::CBackend::create({nullOptions}, Aquamarine::SBackendOptions{});
+    if (!backend || backend->getImplementations().empty()) {
+        std::cout << "Failed to create a null backend\n";
+        return 1;
+    }
+
+    auto nullBackend = dynamicPointerCast<Aquamarine::CNullBackend>(backend->getImplementations().at(0));
+    nullBackend->setFormats({Aquamarine::SDRMFormat{.drmFormat = DRM_FORMAT_ARGB8888, .modifiers = {DRM_FORMAT_MOD_LINEAR}}});
+
+    const int FD = openRenderNode();
+    if (FD < 0) {
+        std::cout << "No render node to allocate from, skipping\n";
+        return SKIP;
+    }
+
+    // takes the fd
+    auto allocator = Aquamarine::CGBMAllocator::create(FD, backend);
+    if (!allocator) {
+        close(FD);
+        std::cout << "No gbm on the render node, skipping\n";
+        return SKIP;
+    }
+
+    auto                                swapchain = Aquamarine::ISwapchain::createLegacy(allocator, nullBackend);
+
+    const Aquamarine::SSwapchainOptions OLD_OPTIONS = {.length = 2, .size = {256, 256}, .format = DRM_FORMAT_ARGB8888};
+    const Aquamarine::SSwapchainOptions NEW_OPTIONS = {.length = 2, .size = {512, 256}, .format = DRM_FORMAT_ARGB8888};
+
+    // nothing is handed over before the backend's loop picks it up
+    EXPECT(swapchain->preallocate(OLD_OPTIONS), true);
+    EXPECT(swapchain->preallocated(OLD_OPTIONS), false);
+
+    // a newer request supersedes the older one, whichever worker finishes first
+    EXPECT(swapchain->preallocate(NEW_OPTIONS), true);
+    EXPECT(swapchain->preallocated(NEW_OPTIONS), false);
+
+    const auto END = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!swapchain->preallocated(NEW_OPTIONS) && std::chrono::steady_clock::now() < END) {
+        backend->dispatchOnce(100);
+    }
+    EXPECT(swapchain->preallocated(NEW_OPTIONS), true);
+
+    // the superseded buffers end up in the pool once their worker is done
+    allocator->flushAsync();
+    EXPECT(swapchain->preallocated(OLD_OPTIONS), false);
+    EXPECT(allocator->pooledBuffers(), 2);
+
+    auto stats = allocator->stats();
+    EXPECT(stats.allocations, 4);
+    EXPECT(stats.failures, 0);
+
+    // buffers from the worker device are ordinary dmabufs, and are used as they are
+    EXPECT(swapchain->reconfigure(NEW_OPTIONS), true);
+    auto buffer = swapchain->next(nullptr);
+    EXPECT(!!buffer, true);
+    if (!buffer)
+        return 1;
+
+    const auto ATTRS = buffer->dmabuf();
+    EXPECT(ATTRS.success, true);
+    EXPECT(ATTRS.planes >= 1, true);
+    EXPECT(ATTRS.fds.at(0) >= 0, true);
+    EXPECT(ATTRS.size, NEW_OPTIONS.size);
+    EXPECT(ATTRS.format, DRM_FORMAT_ARGB8888);
+
+    EXPECT(swapchain->reconfigure(OLD_OPTIONS), true);
+    EXPECT(allocator->stats().allocations, 4);
+
+    buffer.reset();
+    swapchain.reset();
+    return ret;
+}
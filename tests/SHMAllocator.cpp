@@ -0,0 +1,113 @@
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <cstring>
+#include <numeric>
+#include "shared.hpp"
+
+using namespace Hyprutils::Memory;
+
+int main() {
+    int                                       ret = 0;
+
+    Aquamarine::SBackendImplementationOptions headlessOptions;
+    headlessOptions.backendType        = Aquamarine::eBackendType::AQ_BACKEND_HEADLESS;
+    headlessOptions.backendRequestMode = Aquamarine::eBackendRequestMode::AQ_BACKEND_REQUEST_MANDATORY;
+
+    // no drm device anywhere, so this has to run on the shm allocator
+    auto backend = Aquamarine::CBackend::create({headlessOptions}, Aquamarine::SBackendOptions{});
+    if (!backend || !backend->start()) {
+        std::cout << "Failed to start a headless backend\n";
+        return 1;
+    }
+
+    EXPECT(!!backend->primaryAllocator, true);
+    if (!backend->primaryAllocator)
+        return 1;
+
+    EXPECT(backend->primaryAllocator->type(), Aquamarine::AQ_ALLOCATOR_TYPE_SHM);
+    EXPECT(backend->primaryAllocator->drmFD(), -1);
+
+    auto swapchain = Aquamarine::ISwapchain::createLegacy(backend->primaryAllocator, backend->getImplementations().at(0));
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {100, 50}, .format = DRM_FORMAT_XRGB8888}), true);
+
+    auto buffer = swapchain->next(nullptr);
+    EXPECT(!!buffer, true);
+    if (!buffer)
+        return 1;
+
+    EXPECT(buffer->type(), Aquamarine::BUFFER_TYPE_SHM);
+    EXPECT(buffer->caps() & Aquamarine::BUFFER_CAPABILITY_DATAPTR, Aquamarine::BUFFER_CAPABILITY_DATAPTR);
+
+    const auto ATTRS = buffer->shm();
+    EXPECT(ATTRS.success, true);
+    EXPECT(ATTRS.fd >= 0, true);
+    EXPECT(ATTRS.format, DRM_FORMAT_XRGB8888);
+    EXPECT(ATTRS.stride >= 100 * 4, true);
+
+    // the mapping stays the same between accesses, and is writable
+    auto [data, format, len] = buffer->beginDataPtr(0);
+    buffer->endDataPtr();
+    EXPECT(data != nullptr, true);
+    if (!data)
+        return 1;
+
+    EXPECT(len, (size_t)ATTRS.stride * 50);
+    memset(data, 0xAB, len);
+    EXPECT(std::get<0>(buffer->beginDataPtr(0)) == data, true);
+    buffer->endDataPtr();
+    EXPECT((int)data[len - 1], 0xAB);
+
+    // formats we don't know the layout of are refused
+    EXPECT(!!backend->primaryAllocator->acquire(Aquamarine::SAllocatorBufferParams{.size = {64, 64}, .format = DRM_FORMAT_NV12}, nullptr), false);
+
+    // everything handed out is accounted for, by format and by owner
+    const uint64_t BYTES = (uint64_t)ATTRS.stride * 50;
+    auto           stats = backend->primaryAllocator->stats();
+    EXPECT(stats.liveBuffers, 2);
+    EXPECT(stats.liveBytes, 2 * BYTES);
+    EXPECT(stats.allocations, 2);
+    EXPECT(stats.failures, 1);
+    EXPECT(std::accumulate(stats.latency.begin(), stats.latency.end(), (uint64_t)0), 2);
+    EXPECT(stats.formats.size(), 1);
+    EXPECT(stats.formats.at(0).format, DRM_FORMAT_XRGB8888);
+    EXPECT(stats.formats.at(0).modifier, DRM_FORMAT_MOD_LINEAR);
+    EXPECT(stats.formats.at(0).bytes, 2 * BYTES);
+    EXPECT(stats.owners.size(), 1);
+    EXPECT(stats.owners.at(0).swapchain.lock() == swapchain, true);
+    EXPECT(stats.owners.at(0).buffers, 2);
+
+    // dropped buffers belong to nobody while they're pooled
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {200, 100}, .format = DRM_FORMAT_XRGB8888}), true);
+    stats = backend->primaryAllocator->stats();
+    EXPECT(stats.liveBuffers, 4);
+    EXPECT(stats.pooledBuffers, 2);
+    EXPECT(stats.pooledBytes, 2 * BYTES);
+    EXPECT(stats.owners.size(), 2);
+    for (auto const& o : stats.owners) {
+        EXPECT(o.buffers, 2);
+        EXPECT(o.swapchain.expired() ? o.bytes == 2 * BYTES : o.bytes > 2 * BYTES, true);
+    }
+
+    // freed ones are gone from the totals, the peak stays
+    buffer.reset();
+    backend->primaryAllocator->trimPool();
+    stats = backend->primaryAllocator->stats();
+    EXPECT(stats.liveBuffers, 2);
+    EXPECT(stats.peakBuffers, 4);
+    EXPECT(stats.pooledBuffers, 0);
+    EXPECT(stats.owners.size(), 1);
+
+    // without a format, one the backend renders to is picked
+    auto autoSwapchain = Aquamarine::ISwapchain::createLegacy(backend->primaryAllocator, backend->getImplementations().at(0));
+    EXPECT(autoSwapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 1, .size = {64, 64}, .format = DRM_FORMAT_INVALID}), true);
+    auto autoBuffer = autoSwapchain->next(nullptr);
+    EXPECT(!!autoBuffer, true);
+    if (!autoBuffer)
+        return 1;
+
+    EXPECT(autoBuffer->shm().success, true);
+    EXPECT(autoBuffer->shm().format, DRM_FORMAT_ARGB8888);
+
+    return ret;
+}
@@ -25,8 +25,9 @@ void aqLog(Aquamarine::eBackendLogLevel level, std::string msg) {
     std::cout << "[AQ] [" << aqLevelToString(level) << "] " << msg << "\n";
 }
 
-CHyprSignalListener     newOutputListener, outputFrameListener, outputStateListener, mouseMotionListener, keyboardKeyListener, newMouseListener, newKeyboardListener;
-SP<Aquamarine::IOutput> output;
+CHyprSignalListener                newOutputListener, outputFrameListener, outputStateListener, mouseMotionListener, keyboardKeyListener, newMouseListener, newKeyboardListener;
+SP<Aquamarine::IOutput>            output;
+CWeakPointer<Aquamarine::CBackend> backend;
 
 //
 void onFrame() {
@@ -36,6 +37,10 @@ void onFrame() {
 
     output->state->setBuffer(buf);
     output->commit();
+
+    // one frame shows the whole path works, we're done
+    if (auto b = backend.lock())
+        b->stopLoop();
 }
 
 void onState(const Aquamarine::IOutput::SStateEvent& event) {
@@ -84,8 +89,18 @@ int main(int argc, char** argv, char** envp) {
         return 1;
     }
 
-    // FIXME: write an event loop.
-    // aqBackend->enterLoop();
+    // quit after the first frame, or after a bit if none comes
+    backend   = aqBackend;
+    auto quit = makeShared<std::function<void(void)>>([]() {
+        if (auto b = backend.lock())
+            b->stopLoop();
+    });
+    aqBackend->addTimer(quit, 500);
+
+    if (!aqBackend->enterLoop()) {
+        std::cout << "Event loop failed\n";
+        return 1;
+    }
 
     return 0;
 }
@@ -0,0 +1,354 @@
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <aquamarine/backend/Null.hpp>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "shared.hpp"
+
+using namespace Hyprutils::Memory;
+using namespace Hyprutils::Math;
+#define SP CSharedPointer
+
+class CTestBuffer : public Aquamarine::IBuffer {
+  public:
+    CTestBuffer(const Aquamarine::SAllocatorBufferParams& params, uint64_t modifier_ = DRM_FORMAT_MOD_LINEAR) : format(params.format), modifier(modifier_) {
+        size = params.size;
+    }
+
+    virtual Aquamarine::eBufferCapability caps() {
+        return Aquamarine::BUFFER_CAPABILITY_NONE;
+    }
+
+    virtual Aquamarine::eBufferType type() {
+        return Aquamarine::BUFFER_TYPE_MISC;
+    }
+
+    virtual void update(const CRegion& damage) {
+        ;
+    }
+
+    virtual bool isSynchronous() {
+        return true;
+    }
+
+    virtual bool good() {
+        return true;
+    }
+
+    virtual Aquamarine::SDMABUFAttrs dmabuf() {
+        return Aquamarine::SDMABUFAttrs{.success = true, .size = size, .format = format, .modifier = modifier};
+    }
+
+  private:
+    uint32_t format   = DRM_FORMAT_INVALID;
+    uint64_t modifier = DRM_FORMAT_MOD_LINEAR;
+};
+
+class CTestAllocator : public Aquamarine::IAllocator {
+  public:
+    CTestAllocator(SP<Aquamarine::CBackend> backend_) : backend(backend_) {
+        ;
+    }
+
+    virtual SP<Aquamarine::IBuffer> acquire(const Aquamarine::SAllocatorBufferParams& params, SP<Aquamarine::CLegacySwapchain> swapchain) {
+        if (auto pooled = takeFromPool(params, swapchain))
+            return pooled;
+
+        allocated++;
+        auto buffer = makeShared<CTestBuffer>(params, modifier);
+        tagForPool(buffer, params, swapchain);
+        track(buffer, swapchain, (uint64_t)params.size.x * (uint64_t)params.size.y * 4, 0);
+        return buffer;
+    }
+
+    virtual SP<Aquamarine::CBackend> getBackend() {
+        return backend.lock();
+    }
+
+    virtual int drmFD() {
+        return -1;
+    }
+
+    virtual Aquamarine::eAllocatorType type() {
+        return Aquamarine::AQ_ALLOCATOR_TYPE_DRM_DUMB;
+    }
+
+    // with threaded set, results come back like the gbm allocator's: a worker posts a task to the backend's loop to pick them up
+    virtual void acquireAsync(const Aquamarine::SAllocatorBufferParams& params, SP<Aquamarine::CLegacySwapchain> swapchain, size_t count,
+                              Aquamarine::FAsyncBuffersCallback done) {
+        if (!threaded) {
+            IAllocator::acquireAsync(params, swapchain, count, std::move(done));
+            return;
+        }
+
+        auto job       = std::make_unique<SJob>();
+        job->params    = params;
+        job->swapchain = swapchain;
+        job->count     = count;
+        job->done      = std::move(done);
+        job->thread    = std::thread([this, job = job.get(), be = backend.get()]() {
+            job->finished.store(true);
+            be->postTask([this]() { collect(false); });
+        });
+        jobs.emplace_back(std::move(job));
+    }
+
+    virtual void flushAsync() {
+        collect(true);
+    }
+
+    size_t   allocated = 0;
+    uint64_t modifier  = DRM_FORMAT_MOD_LINEAR; // what new buffers get
+    bool     threaded  = false;
+
+    struct SJob {
+        Aquamarine::SAllocatorBufferParams         params;
+        CWeakPointer<Aquamarine::CLegacySwapchain> swapchain;
+        size_t                                     count = 0;
+        Aquamarine::FAsyncBuffersCallback          done;
+        std::thread                                thread;
+        std::atomic<bool>                          finished = false;
+    };
+    std::vector<std::unique_ptr<SJob>> jobs;
+
+  private:
+    CWeakPointer<Aquamarine::CBackend> backend;
+
+    void                               collect(bool wait) {
+        std::vector<std::unique_ptr<SJob>> ready;
+        std::erase_if(jobs, [&ready, wait](auto& job) {
+            if (!wait && !job->finished.load())
+                return false;
+            ready.emplace_back(std::move(job));
+            return true;
+        });
+
+        for (auto const& job : ready) {
+            job->thread.join();
+
+            std::vector<SP<Aquamarine::IBuffer>> buffers;
+            for (size_t i = 0; i < job->count; ++i) {
+                buffers.emplace_back(acquire(job->params, job->swapchain.lock()));
+            }
+            job->done(std::move(buffers));
+        }
+    }
+};
+
+// whether two regions cover exactly the same area
+static bool sameRegion(const CRegion& a, const CRegion& b) {
+    return a.copy().subtract(b).empty() && b.copy().subtract(a).empty();
+}
+
+int main() {
+    int                                       ret = 0;
+
+    Aquamarine::SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = Aquamarine::eBackendType::AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = Aquamarine::eBackendRequestMode::AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend = Aquamarine::CBackend::create({nullOptions}, Aquamarine::SBackendOptions{});
+    if (!backend || backend->getImplementations().empty()) {
+        std::cout << "Failed to create a null backend\n";
+        return 1;
+    }
+
+    auto allocator = makeShared<CTestAllocator>(backend);
+    auto swapchain = Aquamarine::ISwapchain::createLegacy(allocator, backend->getImplementations().at(0));
+
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 3, .size = {64, 64}, .format = DRM_FORMAT_ARGB8888}), true);
+
+    const CRegion DAMAGE_A{0, 0, 8, 8}, DAMAGE_B{16, 16, 8, 8}, DAMAGE_C{32, 32, 8, 8};
+
+    // fresh buffers have undefined contents
+    int  age = -1;
+    auto a   = swapchain->next(&age);
+    EXPECT(age, 0);
+    swapchain->presented(a, DAMAGE_A);
+    a->lockedByBackend = true;
+
+    // a is on screen, so we get another one
+    auto b = swapchain->next(&age);
+    EXPECT(b != a, true);
+    EXPECT(age, 0);
+    swapchain->presented(b, DAMAGE_B);
+    b->lockedByBackend = true;
+    a->lockedByBackend = false;
+
+    auto c = swapchain->next(&age);
+    EXPECT(c != a && c != b, true);
+    swapchain->presented(c, DAMAGE_C);
+    c->lockedByBackend = true;
+
+    // b is still scanned out, a is the least recently presented released one
+    auto next = swapchain->next(&age);
+    EXPECT(next == a, true);
+    EXPECT(age, 3);
+    EXPECT(sameRegion(swapchain->damageForAge(age), CRegion{DAMAGE_B}.add(DAMAGE_C)), true);
+
+    // a rolled back buffer is handed out again
+    swapchain->rollback();
+    EXPECT(swapchain->next(&age) == a, true);
+
+    // a buffer the consumer still holds is skipped too
+    b->lockedByBackend = false;
+    a->lock();
+    EXPECT(swapchain->next(&age) == b, true);
+    EXPECT(age, 2);
+    a->unlock();
+
+    // frames that don't come from the swapchain still age its buffers
+    swapchain->presented(makeShared<CTestBuffer>(Aquamarine::SAllocatorBufferParams{.size = {64, 64}}), DAMAGE_A);
+    EXPECT(swapchain->next(&age) == a, true);
+    EXPECT(age, 4);
+
+    // with everything busy, the oldest buffer is reused rather than failing
+    a->lockedByBackend = b->lockedByBackend = c->lockedByBackend = true;
+    EXPECT(swapchain->next(&age) == a, true);
+
+    // too old for the kept history means a full repaint
+    EXPECT(sameRegion(swapchain->damageForAge(Aquamarine::CSwapchainDamageRing::HISTORY + 2), CRegion{0, 0, 64, 64}), true);
+
+    // a new configuration starts over
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {128, 128}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(swapchain->next(&age) != nullptr, true);
+    EXPECT(age, 0);
+
+    // the old buffers went to the allocator's pool, and come back once nobody holds them anymore
+    EXPECT(allocator->pooledBuffers(), 3);
+    const size_t ALLOCATED = allocator->allocated;
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 3, .size = {64, 64}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(allocator->allocated, ALLOCATED + 3);
+
+    a->lockedByBackend = b->lockedByBackend = c->lockedByBackend = false;
+    a.reset();
+    b.reset();
+    c.reset();
+    next.reset();
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {128, 128}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 3, .size = {64, 64}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(allocator->allocated, ALLOCATED + 3);
+
+    // a different format doesn't match
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {128, 128}, .format = DRM_FORMAT_XRGB8888}), true);
+    EXPECT(allocator->allocated, ALLOCATED + 5);
+
+    // trimming frees the oldest buffers until the pool fits
+    const size_t   POOLED       = allocator->pooledBuffers();
+    const uint64_t POOLED_BYTES = allocator->pooledBytes();
+    EXPECT(POOLED > 1, true);
+    EXPECT(allocator->trimPool(POOLED_BYTES - 1) > 0, true);
+    EXPECT(allocator->pooledBytes() < POOLED_BYTES, true);
+    const size_t LEFT = allocator->pooledBuffers();
+    EXPECT(allocator->trimPool(), LEFT);
+    EXPECT(allocator->pooledBuffers(), 0);
+    EXPECT(allocator->pooledBytes(), 0);
+
+    // the pool holds POOL_MAX_BYTES at most, whatever the buffer count
+    {
+        const Aquamarine::SAllocatorBufferParams QUARTER = {.size = {4096, 2048}, .format = DRM_FORMAT_ARGB8888}; // 32 MiB
+        std::vector<SP<Aquamarine::IBuffer>>     buffers;
+        for (size_t i = 0; i < 5; ++i) {
+            buffers.emplace_back(allocator->acquire(QUARTER, swapchain));
+        }
+
+        CWeakPointer<Aquamarine::IBuffer> oldest = buffers.front(), second = buffers.at(1);
+        for (auto const& b : buffers) {
+            allocator->recycle(b);
+        }
+        buffers.clear();
+
+        EXPECT(allocator->pooledBuffers(), 4);
+        EXPECT(allocator->pooledBytes(), Aquamarine::IAllocator::POOL_MAX_BYTES);
+        EXPECT(oldest.expired(), true);
+        EXPECT(second.expired(), false);
+
+        // one that's bigger than the whole pool isn't kept at all
+        auto                              huge    = allocator->acquire(Aquamarine::SAllocatorBufferParams{.size = {8192, 8192}, .format = DRM_FORMAT_ARGB8888}, swapchain);
+        CWeakPointer<Aquamarine::IBuffer> hugeRef = huge;
+        allocator->recycle(huge);
+        huge.reset();
+        EXPECT(hugeRef.expired(), true);
+        EXPECT(allocator->pooledBuffers(), 0);
+    }
+
+    // a pooled buffer isn't reused once its modifier isn't supported anymore
+    auto           nullBackend = dynamicPointerCast<Aquamarine::CNullBackend>(backend->getImplementations().at(0));
+    const uint64_t MOD_A = fourcc_mod_code(INTEL, 1), MOD_B = fourcc_mod_code(INTEL, 2);
+    nullBackend->setFormats({Aquamarine::SDRMFormat{.drmFormat = DRM_FORMAT_ARGB8888, .modifiers = {MOD_A, MOD_B}}});
+    allocator->modifier = MOD_A;
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {32, 32}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {48, 48}, .format = DRM_FORMAT_ARGB8888}), true);
+    const size_t BEFORE_MODIFIER_CHANGE = allocator->allocated;
+
+    nullBackend->setFormats({Aquamarine::SDRMFormat{.drmFormat = DRM_FORMAT_ARGB8888, .modifiers = {MOD_B}}});
+    allocator->modifier = MOD_B;
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {32, 32}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(allocator->allocated, BEFORE_MODIFIER_CHANGE + 2);
+
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {48, 48}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(allocator->allocated, BEFORE_MODIFIER_CHANGE + 4);
+
+    // while ones that still are come back
+    EXPECT(swapchain->reconfigure(Aquamarine::SSwapchainOptions{.length = 2, .size = {32, 32}, .format = DRM_FORMAT_ARGB8888}), true);
+    EXPECT(allocator->allocated, BEFORE_MODIFIER_CHANGE + 4);
+
+    nullBackend->setFormats({});
+    allocator->trimPool();
+
+    // preallocated buffers are swapped in by the reconfigure they were made for
+    const Aquamarine::SSwapchainOptions PREALLOC_OPTIONS = {.length = 2, .size = {256, 256}, .format = DRM_FORMAT_ARGB8888};
+    EXPECT(swapchain->preallocate(PREALLOC_OPTIONS), true);
+    EXPECT(swapchain->preallocate(PREALLOC_OPTIONS), false);
+    EXPECT(swapchain->preallocated(PREALLOC_OPTIONS), true);
+    const size_t PREALLOCATED = allocator->allocated;
+    EXPECT(swapchain->reconfigure(PREALLOC_OPTIONS), true);
+    EXPECT(allocator->allocated, PREALLOCATED);
+    EXPECT(swapchain->preallocated(PREALLOC_OPTIONS), false);
+    EXPECT(swapchain->preallocate(PREALLOC_OPTIONS), false);
+
+    // in the background, results come in through the backend's loop
+    allocator->threaded = true;
+    allocator->trimPool();
+
+    const Aquamarine::SSwapchainOptions OLD_OPTIONS = {.length = 2, .size = {320, 200}, .format = DRM_FORMAT_ARGB8888};
+    const Aquamarine::SSwapchainOptions NEW_OPTIONS = {.length = 2, .size = {640, 400}, .format = DRM_FORMAT_ARGB8888};
+    EXPECT(swapchain->preallocate(OLD_OPTIONS), true);
+    EXPECT(swapchain->preallocated(OLD_OPTIONS), false);
+
+    // a newer request supersedes the older one, whichever finishes first
+    EXPECT(swapchain->preallocate(NEW_OPTIONS), true);
+    const auto END = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!allocator->jobs.empty() && std::chrono::steady_clock::now() < END) {
+        backend->dispatchOnce(100);
+    }
+    EXPECT(allocator->jobs.empty(), true);
+    EXPECT(swapchain->preallocated(OLD_OPTIONS), false);
+    EXPECT(swapchain->preallocated(NEW_OPTIONS), true);
+
+    // the superseded buffers went to the pool, and are as good as new
+    EXPECT(allocator->pooledBuffers(), 2);
+    const size_t BACKGROUND = allocator->allocated;
+    EXPECT(swapchain->reconfigure(NEW_OPTIONS), true);
+    EXPECT(swapchain->reconfigure(OLD_OPTIONS), true);
+    EXPECT(allocator->allocated, BACKGROUND);
+
+    // a reconfigure doesn't wait for what's still in flight, and what comes in late goes to the pool
+    EXPECT(swapchain->preallocate(NEW_OPTIONS), true);
+    EXPECT(swapchain->reconfigure(NEW_OPTIONS), true);
+    EXPECT(allocator->jobs.empty(), false);
+    EXPECT(allocator->allocated, BACKGROUND);
+
+    const size_t POOLED = allocator->pooledBuffers();
+    const auto   LATE   = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!allocator->jobs.empty() && std::chrono::steady_clock::now() < LATE) {
+        backend->dispatchOnce(100);
+    }
+    EXPECT(allocator->jobs.empty(), true);
+    EXPECT(swapchain->preallocated(NEW_OPTIONS), false);
+    EXPECT(allocator->pooledBuffers(), POOLED + 2);
+
+    return ret;
+}
@@ -0,0 +1,197 @@
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/backend/Tab.hpp>
+#include <aquamarine/output/Output.hpp>
+#include <aquamarine/input/Input.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <new>
+#include <poll.h>
+#include "shared.hpp"
+
+using namespace Hyprutils::Signal;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+
+// ctest's SKIP_RETURN_CODE, for when there's no Shift session to run against
+constexpr int SKIP = 77;
+
+// the backend's own work allocates nothing per frame once its buffers are cached, what's left is signal dispatch to the listeners below
+constexpr size_t MAX_ALLOCS_PER_FRAME = 8;
+
+// frames before the measurement, until every buffer Shift cycles through has been seen once
+constexpr size_t WARMUP_FRAMES = 8;
+
+static std::atomic<size_t> allocations = 0;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(std::max<size_t>(size, 1)))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+using Clock = std::chrono::steady_clock;
+
+static void aqLog(Aquamarine::eBackendLogLevel level, std::string msg) {
+    if (level >= Aquamarine::eBackendLogLevel::AQ_LOG_WARNING)
+        std::cout << "[AQ] " << msg << "\n";
+}
+
+CHyprSignalListener     newOutputListener, presentListener, newPointerListener, moveListener;
+SP<Aquamarine::IOutput> output;
+size_t                  presents = 0, moves = 0;
+Clock::time_point       presentedAt;
+
+// read everything the backend is waiting on, like a compositor's loop would
+static void pump(const std::vector<SP<Aquamarine::SPollFD>>& fds, std::vector<pollfd>& pfds, int timeoutMs) {
+    pfds.resize(fds.size());
+    for (size_t i = 0; i < fds.size(); ++i) {
+        pfds[i] = {.fd = fds[i]->fd, .events = POLLIN, .revents = 0};
+    }
+
+    if (poll(pfds.data(), pfds.size(), timeoutMs) <= 0)
+        return;
+
+    for (size_t i = 0; i < fds.size(); ++i) {
+        if (pfds[i].revents & POLLIN)
+            fds[i]->onSignal();
+    }
+}
+
+// Runs against the Shift session in SHIFT_SESSION_TOKEN, and is skipped without one.
+int main(int argc, char** argv) {
+    int          ret    = 0;
+    const size_t FRAMES = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    const size_t EVENTS = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 100000;
+
+    Aquamarine::SBackendOptions options;
+    options.logFunction = aqLog;
+
+    std::vector<Aquamarine::SBackendImplementationOptions> implementations;
+    Aquamarine::SBackendImplementationOptions              tabOptions;
+    tabOptions.backendType        = Aquamarine::eBackendType::AQ_BACKEND_TAB;
+    tabOptions.backendRequestMode = Aquamarine::eBackendRequestMode::AQ_BACKEND_REQUEST_MANDATORY;
+    implementations.emplace_back(tabOptions);
+
+    auto aqBackend = Aquamarine::CBackend::create(implementations, options);
+
+    newOutputListener = aqBackend->events.newOutput.listen([](const SP<Aquamarine::IOutput> newOutput) {
+        if (output)
+            return;
+        output          = newOutput;
+        presentListener = output->events.present.listen([](const Aquamarine::IOutput::SPresentEvent& event) {
+            presentedAt = Clock::now();
+            presents++;
+        });
+    });
+
+    newPointerListener = aqBackend->events.newPointer.listen([](const SP<Aquamarine::IPointer>& pointer) {
+        moveListener = pointer->events.move.listen([](const Aquamarine::IPointer::SMoveEvent& event) { moves++; });
+    });
+
+    if (!aqBackend || !aqBackend->start()) {
+        std::cout << "No Shift session to run against, skipping\n";
+        return SKIP;
+    }
+
+    if (!output) {
+        std::cout << "The Shift session has no monitors, skipping\n";
+        return SKIP;
+    }
+
+    output->state->setEnabled(true);
+    output->state->setFormat(DRM_FORMAT_XRGB8888);
+    output->commit();
+
+    const auto          FDS = aqBackend->getPollFDs();
+    std::vector<pollfd> pfds;
+    pfds.reserve(FDS.size());
+
+    // acquire -> commit -> frame_done round trips. Shift presents at its refresh rate, so these are paced by vblank
+    Clock::duration total = {}, worst = {};
+    size_t          allocs = 0, worstAllocs = 0;
+    for (size_t i = 0; i < WARMUP_FRAMES + FRAMES; ++i) {
+        const size_t PRESENTS = presents;
+        const size_t ALLOCS   = allocations.load(std::memory_order_relaxed);
+        const auto   START    = Clock::now();
+
+        output->state->setBuffer(output->swapchain->next(nullptr));
+        output->commit();
+        while (presents == PRESENTS) {
+            pump(FDS, pfds, 100);
+            if (Clock::now() - START > std::chrono::seconds(1)) {
+                std::cout << Colors::RED << "Failed: " << Colors::RESET << "frame " << i << " was never presented\n";
+                return 1;
+            }
+        }
+
+        if (i < WARMUP_FRAMES)
+            continue;
+
+        const size_t FRAME_ALLOCS = allocations.load(std::memory_order_relaxed) - ALLOCS;
+        allocs += FRAME_ALLOCS;
+        worstAllocs = std::max(worstAllocs, FRAME_ALLOCS);
+        total += presentedAt - START;
+        worst = std::max(worst, presentedAt - START);
+    }
+
+    EXPECT(presents, WARMUP_FRAMES + FRAMES);
+
+    const auto US = [](Clock::duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+    std::cout << std::format("round trip: {:.2f}us avg, {:.2f}us worst over {} frames\n", US(total) / std::max<size_t>(FRAMES, 1), US(worst), FRAMES);
+    std::cout << std::format("allocations per frame: {:.2f} avg, {} worst\n", (double)allocs / std::max<size_t>(FRAMES, 1), worstAllocs);
+
+    // a steady stream of frames can't allocate more and more
+    EXPECT(worstAllocs <= MAX_ALLOCS_PER_FRAME, true);
+
+    // input throughput through the backend's event translation. Shift can't be made to send input, so events are fed where
+    // dispatchEvents hands them over after reading them from the socket
+    SP<Aquamarine::CTabBackend> tab;
+    for (auto const& impl : aqBackend->getImplementations()) {
+        if (impl->type() == Aquamarine::eBackendType::AQ_BACKEND_TAB)
+            tab = dynamicPointerCast<Aquamarine::CTabBackend>(impl);
+    }
+
+    EXPECT(!!tab, true);
+    if (!tab)
+        return 1;
+
+    TabInputEvent motion {};
+    motion.kind                   = TAB_INPUT_KIND_POINTER_MOTION;
+    motion.data.pointer_motion.dx = 1.0;
+    motion.data.pointer_motion.dy = 1.0;
+
+    // the first event creates the pointer, keep that out of the measurement
+    bool pointerDirty = false, touchDirty = false;
+    tab->handleInput(&motion, pointerDirty, touchDirty);
+    moves = 0;
+
+    const auto   START  = Clock::now();
+    const size_t ALLOCS = allocations.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < EVENTS; ++i) {
+        tab->handleInput(&motion, pointerDirty, touchDirty);
+    }
+    const auto ELAPSED = Clock::now() - START;
+    const auto EALLOCS = allocations.load(std::memory_order_relaxed) - ALLOCS;
+
+    // with AQ_TAB_COALESCE_INPUT, moves are held until the end of a dispatch
+    if (const auto COALESCE = std::getenv("AQ_TAB_COALESCE_INPUT"); !COALESCE || std::string{COALESCE} != "1")
+        EXPECT(moves, EVENTS);
+
+    std::cout << std::format("input: {:.0f} events/s, {:.3f} allocations per event\n", EVENTS / std::max(std::chrono::duration<double>(ELAPSED).count(), 1e-9),
+                             (double)EALLOCS / std::max<size_t>(EVENTS, 1));
+
+    output.reset();
+    return ret;
+}
@@ -0,0 +1,57 @@
+#include <aquamarine/misc/TaskQueue.hpp>
+#include <memory>
+#include <poll.h>
+#include <thread>
+#include <vector>
+#include "shared.hpp"
+
+constexpr size_t THREADS = 4;
+constexpr size_t TASKS   = 20000;
+
+int main() {
+    Aquamarine::CTaskQueue   queue;
+    int                      ret = 0;
+    size_t                   ran = 0;
+    std::vector<std::thread> producers;
+
+    EXPECT(queue.fd() >= 0, true);
+    EXPECT(queue.drain(), 0);
+
+    // everything runs on this thread, so ran needs no synchronization
+    for (size_t i = 0; i < THREADS; ++i) {
+        producers.emplace_back([&queue, &ran] {
+            for (size_t j = 0; j < TASKS; ++j) {
+                queue.push([&ran] { ran++; });
+            }
+        });
+    }
+
+    pollfd pfd = {.fd = queue.fd(), .events = POLLIN, .revents = 0};
+    while (ran < THREADS * TASKS) {
+        if (poll(&pfd, 1, 1000) <= 0)
+            break;
+        queue.drain();
+    }
+
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    EXPECT(ran, THREADS * TASKS);
+
+    // nothing left, nothing to wake up for
+    EXPECT(poll(&pfd, 1, 0), 0);
+
+    // a closed gate leaves the task with whoever tried to post it
+    auto                      gate = std::make_shared<Aquamarine::CTaskGate>(&queue);
+    std::function<void(void)> task = [&ran] { ran++; };
+    EXPECT(gate->post(task), true);
+    EXPECT(queue.drain(), 1);
+    task = [&ran] { ran++; };
+    gate->close();
+    EXPECT(gate->post(task), false);
+    EXPECT((bool)task, true);
+    EXPECT(poll(&pfd, 1, 0), 0);
+
+    return ret;
+}